@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdio>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../util.hh"
+
+namespace bench {
+
+/* Run fn () iters times, print latency distribution and throughput */
+inline void measure (const std::string& name, size_t iters, const std::function <void ()>& fn,
+                     FILE *out = stdout) {
+    std::vector <double> lat;
+    lat.reserve (iters);
+
+    ev::time total_start = ev::time::monotonic ();
+    for (size_t i = 0; i < iters; ++i) {
+        ev::time start = ev::time::monotonic ();
+        fn ();
+        lat.push_back ((ev::time::monotonic () - start).to_sec ());
+    }
+    double total = (ev::time::monotonic () - total_start).to_sec ();
+
+    std::sort (lat.begin (), lat.end ());
+    auto pct = [&lat] (double p) {
+        return lat[std::min (lat.size () - 1, (size_t)(p * lat.size ()))] * 1e6;
+    };
+
+    fprintf (out, "%-32s n=%-7zu min %9.1fus  p50 %9.1fus  p90 %9.1fus  p99 %9.1fus  max %9.1fus  %10.1f/s\n",
+             name.c_str (), iters, pct (0), pct (0.5), pct (0.9), pct (0.99), pct (1),
+             iters / total);
+    fflush (out);
+}
+
+} // namespace bench
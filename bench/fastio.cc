@@ -0,0 +1,135 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+#define FASTIO_NO_GLOBALS
+#include "bench.hh"
+#include "../fastio.hh"
+
+/*
+ * Reading and writing n integers (10^7 by default) with cin, scanf and
+ * the fastio template. Input is a regular file, as on most judges, and
+ * a pipe, where fast_in cannot mmap.
+ */
+
+static long long sink;
+
+void rewind_stdin (int fd) {
+    dup2 (fd, 0);
+    lseek (0, 0, SEEK_SET);
+    clearerr (stdin);
+    fseek (stdin, 0, SEEK_SET);
+    std::cin.clear ();
+    std::cin.seekg (0);
+}
+
+int main (int argc, char **argv) {
+    int n = argc > 1 ? atoi (argv[1]) : 10 * 1000 * 1000;
+    int iters = argc > 2 ? atoi (argv[2]) : 3;
+
+    char path[] = "/tmp/evx-bench-XXXXXX";
+    int fd = mkstemp (path);
+    if (fd < 0)
+        ev::die_errno ("mkstemp", errno);
+    unlink (path);
+    {
+        FILE *f = fdopen (dup (fd), "w");
+        std::mt19937 rnd (1);
+        fprintf (f, "%d\n", n);
+        for (int i = 0; i < n; ++i)
+            fprintf (f, "%d ", (int)(rnd () % 2000000001) - 1000000000);
+        fclose (f);
+    }
+    printf ("%d integers, %lldM\n", n, (long long)lseek (fd, 0, SEEK_END) >> 20);
+
+    std::ios_base::sync_with_stdio (0);
+    std::cin.tie (0);
+
+    bench::measure ("read cin", iters, [fd] () {
+        rewind_stdin (fd);
+        int cnt, x;
+        std::cin >> cnt;
+        for (int i = 0; i < cnt; ++i)
+            std::cin >> x, sink += x;
+    });
+
+    bench::measure ("read scanf", iters, [fd] () {
+        rewind_stdin (fd);
+        int cnt, x;
+        if (scanf ("%d", &cnt) != 1)
+            return;
+        for (int i = 0; i < cnt; ++i)
+            if (scanf ("%d", &x) == 1)
+                sink += x;
+    });
+
+    bench::measure ("read fast_in (mmap)", iters, [fd] () {
+        rewind_stdin (fd);
+        fast_in *in = new fast_in ();
+        int cnt = in->i32 ();
+        for (int i = 0; i < cnt; ++i)
+            sink += in->i32 ();
+        delete in;
+    });
+
+    bench::measure ("read fast_in (pipe)", iters, [fd] () {
+        int fds[2];
+        if (pipe (fds) != 0)
+            ev::die_errno ("pipe", errno);
+        pid_t pid = fork ();
+        if (pid == 0) {
+            close (fds[0]);
+            lseek (fd, 0, SEEK_SET);
+            char buf[1 << 16];
+            ssize_t r;
+            while ((r = read (fd, buf, sizeof (buf))) > 0)
+                if (write (fds[1], buf, r) != r)
+                    break;
+            _exit (0);
+        }
+        close (fds[1]);
+        dup2 (fds[0], 0);
+        close (fds[0]);
+        fast_in *in = new fast_in ();
+        int cnt = in->i32 ();
+        for (int i = 0; i < cnt; ++i)
+            sink += in->i32 ();
+        delete in;
+        waitpid (pid, NULL, 0);
+    });
+
+    /* Writers go to /dev/null, the report to the real stdout */
+    fflush (stdout);
+    FILE *report = fdopen (dup (1), "w");
+    int null = open ("/dev/null", O_WRONLY);
+    dup2 (null, 1);
+
+    bench::measure ("write cout", iters, [n] () {
+        for (int i = 0; i < n; ++i)
+            std::cout << i - n / 2 << ' ';
+        std::cout.flush ();
+    }, report);
+
+    bench::measure ("write printf", iters, [n] () {
+        for (int i = 0; i < n; ++i)
+            printf ("%d ", i - n / 2);
+        fflush (stdout);
+    }, report);
+
+    bench::measure ("write fast_out", iters, [n] () {
+        fast_out *out = new fast_out ();
+        for (int i = 0; i < n; ++i) {
+            out->i64 (i - n / 2);
+            out->ch (' ');
+        }
+        delete out;
+    }, report);
+
+    fclose (report);
+    return sink == 42;
+}
@@ -0,0 +1,146 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "bench.hh"
+#include "../evx.hh"
+
+/*
+ * evx's own overhead per call, on synthetic repos of 10 to 100k records:
+ * finding the repo dir, parsing the repo file, writing it back, building
+ * the compiler command line, spawning through exec_cc, and a whole
+ * 'evx -r' on an up-to-date target against exec'ing its binary directly.
+ *
+ * The destructor of ev::repo always writes, so 'repo () + ~repo ()' is
+ * parse and write together; 'repo::write' alone is measured next to it.
+ */
+
+static std::string evx_path;
+
+/* <dir>/.evd/evil with n records, each with the keys a built source has */
+void make_repo (const std::string& dir, size_t n) {
+    mkdir (dir.c_str (), 0755);
+    mkdir ((dir + "/.evd").c_str (), 0755);
+    mkdir ((dir + "/src").c_str (), 0755);
+
+    std::ofstream os (dir + "/.evd/evil");
+    os << "std = -std=c++17\nwarn = -Wall\n\n";
+    for (size_t i = 0; i < n; ++i) {
+        std::string hex = ev::n2hex ((uint32_t)i);
+        os << "[" << dir << "/src/" << i << ".cc]\n"
+           << "cc_time_full = " << ev::time (0, 500000000 + i).to_string () << "\n"
+           << "dep:" << dir << "/src/a.hh = " << ev::time (1700000000 + i).to_string () << "\n"
+           << "dep:" << dir << "/src/b.hh = " << ev::time (1700000000 + i).to_string () << "\n"
+           << "exec_filename = " << dir << "/.evd/00000000" << hex << "\n"
+           << "mod_time = " << ev::time (1700000000 + i).to_string () << "\n\n";
+    }
+
+    std::ofstream src (dir + "/src/main.cc");
+    src << "int main () { return 0; }\n";
+}
+
+void rm_tree (const std::string& dir) {
+    ev::spawn_wait ({ "rm", "-rf", dir });
+}
+
+ev::exit_info run_quiet (const std::vector <std::string>& args) {
+    ev::spawn_attr attr;
+    attr.fd_out = attr.fd_err = open ("/dev/null", O_WRONLY | O_CLOEXEC);
+    auto ret = ev::spawn_wait (args, attr);
+    close (attr.fd_out);
+    return ret;
+}
+
+void bench_repo (const std::string& root, size_t n) {
+    std::string dir = root + "/r" + std::to_string (n);
+    make_repo (dir, n);
+    if (chdir (dir.c_str ()) != 0)
+        ev::die_errno (dir.c_str (), errno);
+
+    size_t iters = std::max ((size_t)3, std::min ((size_t)2000, 100000 / n));
+    std::string tag = " n=" + std::to_string (n);
+
+    bench::measure ("repo () + ~repo ()" + tag, iters, [] () {
+        ev::repo r;
+    });
+
+    {
+        ev::repo r;
+        bench::measure ("repo::write" + tag, iters, [&r] () {
+            r.write ();
+        });
+    }
+
+    /* A built record: where sub_args and exec_cc start from */
+    ev::path main_src (dir + "/src/main.cc");
+    if (run_quiet ({ evx_path, "-b", main_src.str () }).status != 0)
+        die_msg ("%s -b %s failed", evx_path.c_str (), main_src.c_str ());
+
+    if (n == 10) {
+        cmd_options opts;
+        ev::repo r;
+        auto& conf = r.get_conf ();
+        auto& rec = r[main_src];
+        bench::measure ("sub_args", 20000, [&conf, &rec, &opts] () {
+            sub_args (conf, rec, opts);
+        });
+        bench::measure ("exec_cc /bin/true", 2000, [] () {
+            exec_cc ({ "/bin/true" });
+        });
+
+        ev::path exec = exec_output (conf, rec);
+        bench::measure ("exec built target", 2000, [&exec] () {
+            run_quiet ({ exec.str () });
+        });
+    }
+
+    if (n == 10) {
+        /* find_dir walks up with access (): same repo from 8 levels down */
+        std::string deep = dir;
+        for (int i = 0; i < 8; ++i) {
+            deep += "/d";
+            mkdir (deep.c_str (), 0755);
+        }
+        if (chdir (deep.c_str ()) != 0)
+            ev::die_errno (deep.c_str (), errno);
+        bench::measure ("repo () + ~repo () depth 8" + tag, iters, [] () {
+            ev::repo r;
+        });
+        if (chdir (dir.c_str ()) != 0)
+            ev::die_errno (dir.c_str (), errno);
+    }
+
+    bench::measure ("evx -r up to date" + tag, std::min (iters, (size_t)500), [&main_src] () {
+        run_quiet ({ evx_path, "-r", main_src.str () });
+    });
+
+    if (chdir (root.c_str ()) != 0)
+        ev::die_errno (root.c_str (), errno);
+    rm_tree (dir);
+}
+
+int main (int argc, char **argv) {
+    char buf[PATH_MAX];
+    if (!realpath (argc > 1 ? argv[1] : "./evx", buf))
+        ev::die_errno ("evx", errno);
+    evx_path = buf;
+    size_t max_records = argc > 2 ? atoi (argv[2]) : 100000;
+
+    char root[] = "/tmp/evx-bench-self-XXXXXX";
+    if (!mkdtemp (root))
+        ev::die_errno ("mkdtemp", errno);
+
+    for (size_t n = 10; n <= max_records; n *= 10)
+        bench_repo (root, n);
+
+    rm_tree (root);
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "bench.hh"
+#include "../spawn.hh"
+
+/*
+ * Spawn throughput: ev::spawn against the old fork+strdup launcher. The
+ * ballast mapping makes the parent look like a process with a real heap,
+ * which is what fork has to copy page tables for.
+ */
+int main (int argc, char **argv) {
+    size_t iters = argc > 1 ? atoi (argv[1]) : 2000;
+    size_t ballast = (argc > 2 ? atoi (argv[2]) : 256) << 20;
+
+    char *mem = (char *)mmap (NULL, ballast, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+        ev::die_errno ("mmap", errno);
+    memset (mem, 1, ballast);
+
+    std::vector <std::string> args = { "/bin/true" };
+
+    bench::measure ("fork+execvp", iters, [&args] () {
+        char **c_vec_args = (char **)malloc ((args.size () + 1) * sizeof (char *));
+        for (size_t i = 0; i < args.size (); ++i)
+            c_vec_args[i] = strdup (args[i].c_str ());
+        c_vec_args[args.size ()] = NULL;
+
+        pid_t pid = fork ();
+        if (pid == 0) {
+            execvp (c_vec_args[0], c_vec_args);
+            _exit (127);
+        }
+        for (size_t i = 0; i < args.size (); ++i)
+            free (c_vec_args[i]);
+        free (c_vec_args);
+
+        int wstatus;
+        waitpid (pid, &wstatus, 0);
+    });
+
+    bench::measure ("ev::spawn_wait", iters, [&args] () {
+        ev::spawn_wait (args);
+    });
+
+    munmap (mem, ballast);
+    return 0;
+}
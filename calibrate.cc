@@ -0,0 +1,136 @@
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "calibrate.hh"
+#include "util.hh"
+
+namespace ev {
+
+namespace {
+
+const int RUNS = 5;
+
+/* Results go here so the work cannot be optimized away */
+volatile uint64_t sink;
+
+void cpu_kernel () {
+    uint64_t x = 0x9E3779B97F4A7C15ULL, acc = 0;
+    for (int i = 0; i < 100 * 1000 * 1000; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        acc += x * 0xBF58476D1CE4E5B9ULL;
+    }
+    sink = acc;
+}
+
+void mem_bw_kernel () {
+    const size_t size = 64 << 20;
+    std::vector <char> a (size, 1), b (size);
+    for (int i = 0; i < 8; ++i) {
+        memcpy (b.data (), a.data (), size);
+        a[i] = b[size - 1 - i];
+    }
+    sink = a[0] + b[size / 2];
+}
+
+void cache_lat_kernel () {
+    /* Sattolo: one cycle through all slots, no loop short enough to cache */
+    const size_t n = (32 << 20) / sizeof (uint32_t);
+    static std::vector <uint32_t> next;
+    if (next.empty ()) {
+        next.resize (n);
+        std::iota (next.begin (), next.end (), 0);
+        std::mt19937 rnd (1);
+        for (size_t i = n - 1; i > 0; --i)
+            std::swap (next[i], next[std::uniform_int_distribution <size_t> (0, i - 1) (rnd)]);
+    }
+
+    uint32_t p = 0;
+    for (int i = 0; i < 2 * 1000 * 1000; ++i)
+        p = next[p];
+    sink = p;
+}
+
+void io_kernel () {
+    int fd = memfd_create ("evx-calibrate", MFD_CLOEXEC);
+    if (fd < 0)
+        throw std::runtime_error (std::string ("memfd_create: ") + strerror (errno));
+
+    char buf[4096];
+    memset (buf, 'x', sizeof (buf));
+    const int blocks = 32 * 1024;
+    ssize_t total = 0;
+    for (int i = 0; i < blocks; ++i)
+        total += write (fd, buf, sizeof (buf));
+    lseek (fd, 0, SEEK_SET);
+    for (ssize_t n; (n = read (fd, buf, sizeof (buf))) > 0; )
+        total += n;
+    close (fd);
+    sink = total;
+}
+
+double median_time (void (*kernel) ()) {
+    kernel ();      /* warm up: page faults, frequency ramp */
+    std::vector <double> times;
+    for (int i = 0; i < RUNS; ++i) {
+        ev::time start = ev::time::monotonic ();
+        kernel ();
+        times.push_back ((ev::time::monotonic () - start).to_sec ());
+    }
+    std::sort (times.begin (), times.end ());
+    return times[RUNS / 2];
+}
+
+} // namespace
+
+machine_profile calibrate_machine () {
+    static const struct {
+        const char *name;
+        void (*kernel) ();
+    } kernels[] = {
+        { "cpu",       cpu_kernel },
+        { "mem_bw",    mem_bw_kernel },
+        { "cache_lat", cache_lat_kernel },
+        { "io",        io_kernel },
+    };
+
+    machine_profile res;
+    for (auto& k: kernels) {
+        char buf[32];
+        snprintf (buf, sizeof (buf), "%.6f", median_time (k.kernel));
+        res[k.name] = buf;
+    }
+    return res;
+}
+
+double judge_ratio (const machine_profile& local, const machine_profile& judge) {
+    double log_sum = 0;
+    int cnt = 0;
+    for (auto& kv: judge) {
+        auto it = local.find (kv.first);
+        if (it == local.end ())
+            continue;
+        double l = atof (it->second.c_str ()), j = atof (kv.second.c_str ());
+        if (l <= 0 || j <= 0)
+            continue;
+        log_sum += std::log (j / l);
+        ++cnt;
+    }
+    return cnt ? std::exp (log_sum / cnt) : 0;
+}
+
+} // namespace ev
@@ -0,0 +1,26 @@
+#pragma once
+#include <map>
+#include <string>
+
+namespace ev {
+
+/*
+ * Fixed amounts of work that stress what solutions are bound by:
+ *     cpu        integer multiply/xor chain
+ *     mem_bw     streaming copies, far over any cache
+ *     cache_lat  dependent loads in a random cycle over 32M
+ *     io         small writes and reads through the page cache
+ * Each is timed as the median of a few runs, in seconds. Profiles of two
+ * machines taken by the same evx compare kernel by kernel.
+ */
+typedef std::map <std::string, std::string> machine_profile;
+
+machine_profile calibrate_machine ();
+
+/*
+ * How many times slower the judge is: geometric mean of the kernel time
+ * ratios both profiles have, 0 if they share none.
+ */
+double judge_ratio (const machine_profile& local, const machine_profile& judge);
+
+} // namespace ev
@@ -0,0 +1,110 @@
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <sched.h>
+#include <sys/resource.h>
+
+#include <stdexcept>
+
+#include "env.hh"
+
+extern char **environ;
+
+namespace ev {
+
+namespace {
+
+/* "0-3,6": every cpu below CPU_SETSIZE, an empty list would mean inherit */
+std::vector <int> parse_cpus (const std::string& str) {
+    auto bad = [&str] () { return std::runtime_error ("bad cpu list: " + str); };
+    auto number = [&bad] (const char *p, char **end) {
+        if (!isdigit ((unsigned char)*p))
+            throw bad ();
+        long res = strtol (p, end, 10);
+        if (res >= CPU_SETSIZE)
+            throw bad ();
+        return res;
+    };
+
+    std::vector <int> res;
+    const char *p = str.c_str ();
+    while (*p) {
+        char *end;
+        long lo = number (p, &end), hi = lo;
+        if (*end == '-')
+            hi = number (end + 1, &end);
+        if (hi < lo || (*end && *end != ','))
+            throw bad ();
+        for (long cpu = lo; cpu <= hi; ++cpu)
+            res.push_back (cpu);
+        p = *end ? end + 1 : end;
+    }
+    if (res.empty ())
+        throw bad ();
+    return res;
+}
+
+/* Set key, or append to its current value after sep if sep is given */
+void set_env (std::vector <std::string>& env, const std::string& key, const std::string& value,
+              const char *sep = NULL) {
+    for (auto& kv: env)
+        if (kv.compare (0, key.size () + 1, key + "=") == 0) {
+            kv = sep ? kv + sep + value : key + "=" + value;
+            return;
+        }
+    env.push_back (key + "=" + value);
+}
+
+} // namespace
+
+void apply_env (const repo::conf_t& profile, spawn_attr& attr) {
+    for (auto& kv: profile) {
+        if (kv.first == "stack") {
+            struct rlimit lim;
+            getrlimit (RLIMIT_STACK, &lim);
+            rlim_t want = kv.second == "unlimited" ? RLIM_INFINITY : ev::parse_size (kv.second);
+            if (lim.rlim_max != RLIM_INFINITY && (want == RLIM_INFINITY || want > lim.rlim_max)) {
+                ev::log (LOG_WARN, "stack limited to hard limit %lluK",
+                         (unsigned long long)lim.rlim_max >> 10);
+                want = lim.rlim_max;
+            }
+            lim.rlim_cur = want;
+            attr.rlimits.push_back (std::make_pair (RLIMIT_STACK, lim));
+        }
+        else if (kv.first == "thp") {
+            if (kv.second == "never")
+                attr.thp_disable = true;
+            else if (kv.second != "always")
+                throw std::runtime_error ("thp is always or never");
+        }
+        else if (kv.first == "cpus")
+            attr.cpus = parse_cpus (kv.second);
+        else if (kv.first != "preload")
+            throw std::runtime_error ("unknown env key: " + kv.first);
+    }
+
+    auto thp = profile.find ("thp");
+    auto preload = profile.find ("preload");
+    bool hugetlb = thp != profile.end () && thp->second == "always";
+    if (!hugetlb && preload == profile.end ())
+        return;
+
+    if (attr.env.empty ())
+        for (char **e = environ; *e; ++e)
+            attr.env.push_back (*e);
+
+    /* glibc >= 2.35 madvise()s its heap with MADV_HUGEPAGE */
+    if (hugetlb)
+        set_env (attr.env, "GLIBC_TUNABLES", "glibc.malloc.hugetlb=1", ":");
+    if (preload != profile.end ())
+        set_env (attr.env, "LD_PRELOAD", preload->second);
+}
+
+std::string describe_env (const repo::conf_t& profile) {
+    std::string res;
+    for (auto& kv: profile)
+        res += (res.empty () ? "" : " ") + kv.first + "=" + kv.second;
+    return res;
+}
+
+} // namespace ev
@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+
+#include "repo.hh"
+#include "spawn.hh"
+
+namespace ev {
+
+/*
+ * Runtime environment profile, an [env <name>] section of the repo file:
+ *     stack   = unlimited | <n>[KMG]   RLIMIT_STACK
+ *     thp     = always | never         transparent huge pages for malloc
+ *     preload = <path>                 LD_PRELOAD, e.g. an allocator
+ *     cpus    = 0,2-3                  affinity
+ */
+void apply_env (const repo::conf_t& profile, spawn_attr& attr);
+
+/* "stack=unlimited thp=always" */
+std::string describe_env (const repo::conf_t& profile);
+
+} // namespace ev
@@ -1,21 +1,107 @@
+#include <climits>
+#include <cmath>
 #include <cstring>
 #include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
 
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/mman.h>
 #include <sys/resource.h>
+#include <sys/syscall.h>
+#include <poll.h>
 #include <signal.h>
 
+#include <algorithm>
 #include <fstream>
 #include <iterator>
 #include <sstream>
 #include <iostream>
+#include <memory>
+#include <set>
+#include <thread>
 
 #include "evx.hh"
+#include "env.hh"
+#include "headers.hh"
+#include "inspect.hh"
+#include "metrics.hh"
+#include "calibrate.hh"
+#include "reduce.hh"
 #include "arg.h"
 
+static const char *EV_INSPECT_GCC = "-fopt-info-vec-inline-optimized-missed=";
+static const char *EV_INSPECT_CLANG[] = {
+    "-Rpass=loop-vectorize|inline",
+    "-Rpass-missed=loop-vectorize|inline",
+    "-Rpass-analysis=loop-vectorize",
+    NULL
+};
+
+static const char *EV_BUILD_SYMBOLS = "-g";
+static const char *EV_BUILD_OPTIMIZE = "-O3";
+static const char *EV_BUILD_MACRO = "-D_LOCAL_SRC";
+static const char *EV_BUILD_SYNTAX = "-fsyntax-only";
+
+static const char *EV_MEM_DIR = "/dev/shm/evx";
+static const ev::path EV_RESULTS_FILE = ev::path ("results");
+
+/* conf keys read by evx itself, the rest is passed to the compiler */
+static const char *EV_CONF_KEYS[] = {
+    "toolchain",
+    "memexec",
+    "env",
+    "time_limit",
+    "jobs",
+    "compress",
+    "input_cache",
+    "syntax_check",
+    "judge_ratio",
+    NULL
+};
+
+static const char *EV_CC_TEMPLATE =                                              \
+    "#include <bits/stdc++.h>\n"                                                 \
+    "using namespace std;\n"                                                     \
+    "typedef long long i64;typedef unsigned long long u64;\n"                    \
+    "#ifdef _LOCAL_SRC\n"                                                        \
+    "#define db(...) fprintf (stderr, __VA_ARGS__)\n"                            \
+    "#define set_io\n"                                                           \
+    "#else\n"                                                                    \
+    "#define db(...)\n"                                                          \
+    "#define set_io {ios_base::sync_with_stdio(0);cin.tie(0);cout.tie(0);}\n"    \
+    "#endif\n\n"                                                                 \
+                                                                                 \
+    "int main () {\n"                                                            \
+    "    set_io;\n\n"                                                            \
+    "    return 0;\n"                                                            \
+    "}\n";
+
+/* fastio.hh wrapped in a raw string literal by make */
+static const char *EV_FASTIO_KERNEL =
+#include "fastio.inc"
+    ;
+
+static const char *EV_CC_TEMPLATE_FASTIO_MAIN =                                  \
+    "using namespace std;\n"                                                     \
+    "typedef long long i64;typedef unsigned long long u64;\n"                    \
+    "#ifdef _LOCAL_SRC\n"                                                        \
+    "#define db(...) fprintf (stderr, __VA_ARGS__)\n"                            \
+    "#else\n"                                                                    \
+    "#define db(...)\n"                                                          \
+    "#endif\n\n"                                                                 \
+                                                                                 \
+    "int main () {\n"                                                            \
+    "    int n = fin.i32 ();\n\n"                                                \
+    "    fout.i64 (n);\n"                                                        \
+    "    fout.ch ('\\n');\n"                                                     \
+    "    return 0;\n"                                                            \
+    "}\n";
+
+/* bench/self links everything but main */
+#ifndef EV_NO_MAIN
 int main (int argc, char **argv) {
     cmd_options opts = parse_argv (argc, argv);
     if (opts.quiet)
@@ -23,6 +109,13 @@ int main (int argc, char **argv) {
     else
         ev::set_log_level (LOG_INFO);
 
+    try {
+        ev::set_metrics_sink (opts.metrics);
+    }
+    catch (std::runtime_error& e) {
+        die_msg ("%s", e.what ());
+    }
+
 
     auto get_filename = [opts] (bool must_exist) -> ev::path {
         if (opts.fname.str ().empty ()) {
@@ -41,9 +134,11 @@ int main (int argc, char **argv) {
         switch (opts.cmd) {
             case cmd_options::CMD_INIT:
                 return init ();
+            case cmd_options::CMD_CALIBRATE:
+                return calibrate ();
 
             case cmd_options::CMD_PREP:
-                return prep  (get_filename (false));
+                return prep  (get_filename (false), opts);
 
             case cmd_options::CMD_BUILD:
                 ret = build (get_filename (true), opts);
@@ -58,6 +153,21 @@ int main (int argc, char **argv) {
             case cmd_options::CMD_SHOW:
                 ret = show (get_filename (true));
                 break;
+            case cmd_options::CMD_INSPECT:
+                ret = inspect (get_filename (true), opts);
+                break;
+            case cmd_options::CMD_TEST: {
+                ret = build (get_filename (true), opts);
+                if (ret == 0)
+                    ret = test (get_filename (true), opts);
+                break;
+            }
+            case cmd_options::CMD_REDUCE: {
+                ret = build (get_filename (true), opts);
+                if (ret == 0)
+                    ret = reduce (get_filename (true), opts);
+                break;
+            }
             default:
                 ev::log (LOG_FAIL, "missing command");
                 exit (EXIT_FAILURE);
@@ -65,10 +175,12 @@ int main (int argc, char **argv) {
     }
     catch (std::runtime_error& e) {
         ev::log (LOG_FAIL, "%s", e.what ());
+        ret = EXIT_FAILURE;
     }
 
     return ret;
 }
+#endif
 
 void print_help (const char *progname) {
     static const char *help = \
@@ -80,7 +192,11 @@ void print_help (const char *progname) {
         "    -r        run (and maybe build) target\n"              \
         "    -b        build target\n"                              \
         "    -p        write template into target\n"                \
-        "    -s        show absolute path of executable\n\n"        \
+        "    -s        show absolute path of executable\n"          \
+        "    -e        report vectorization/inlining of target\n"    \
+        "    -c        test (and maybe build) target\n"             \
+        "    -z in     shrink input in on which target fails\n"     \
+        "    -w        time this machine for judge scaling\n\n"     \
         "    -h        print this and exit\n"                       \
         "    -v        print version and exit\n\n"                  \
                                                                     \
@@ -89,15 +205,31 @@ void print_help (const char *progname) {
         "    -y        show system time\n"                          \
         "    -u        show user time\n"                            \
         "    -m        show rss mem usage\n"                        \
+        "    -a        show read/write syscall counts\n"            \
         "    -g        generate %s symbols\n"                       \
         "    -o        optimize with %s\n"                          \
-        "    -d        define %s macro\n\n"                         \
+        "    -d        define %s macro\n"                           \
+        "    -n        narrow bits/stdc++.h to the headers used\n"  \
+        "    -l        with -c, reuse memoized test results\n"      \
+        "    -K        with -c, stop at the first failed test\n"    \
+        "    -f fn     with -e, annotate assembly of function fn\n" \
+        "    -x env    run with [env <env>] profile from repo\n"    \
+        "    -j out    append JSON metrics to fd or file out\n"     \
+        "    -t name   with -p, write template name (%s)\n\n"       \
         "Uppercase options to invert\n"                             ;
 
-    fprintf (stderr, help, progname, EV_BUILD_SYMBOLS, EV_BUILD_OPTIMIZE, EV_BUILD_MACRO);
+    std::string tmpls;
+    for (auto& tmpl: builtin_templates ())
+        tmpls += (tmpls.empty () ? "" : ", ") + tmpl.first;
+    fprintf (stderr, help, progname, EV_BUILD_SYMBOLS, EV_BUILD_OPTIMIZE, EV_BUILD_MACRO,
+             tmpls.c_str ());
     exit (EXIT_SUCCESS);
 }
 
+void missing_arg (char opt) {
+    die_msg ("option -%c needs an argument", opt);
+}
+
 void print_version () {
 #ifdef EV_COMMIT
     fprintf (stderr, "ev 0.1(%s)\n", EV_COMMIT);
@@ -122,59 +254,189 @@ cmd_options parse_argv (int argc, char **argv) {
         case 'b': result.cmd = cmd_options::CMD_BUILD; break;
         case 'p': result.cmd = cmd_options::CMD_PREP; break;
         case 's': result.cmd = cmd_options::CMD_SHOW; break;
+        case 'e': result.cmd = cmd_options::CMD_INSPECT; break;
+        case 'c': result.cmd = cmd_options::CMD_TEST; break;
+        case 'z': result.cmd = cmd_options::CMD_REDUCE; break;
+        case 'w': result.cmd = cmd_options::CMD_CALIBRATE; break;
 
         case 'q': result.quiet =    1; break;
         case 'y': result.show_sys = 1; break;
         case 'u': result.show_usr = 1; break;
         case 'm': result.show_rss = 1; break;
+        case 'a': result.show_io =  1; break;
         case 'g': result.symbols =  1; break;
         case 'o': result.optimize = 1; break;
         case 'd': result.macro =    1; break;
+        case 'n': result.narrow =   1; break;
+        case 'l': result.memo =     1; break;
+        case 'k': result.keep_going = 1; break;
+        case 'f': result.function = EARGF (missing_arg ('f')); break;
+        case 'x': result.env =      EARGF (missing_arg ('x')); break;
+        case 'j': result.metrics =  EARGF (missing_arg ('j')); break;
+        case 't': result.tmpl =     EARGF (missing_arg ('t')); break;
         case 'Q': result.quiet =    0; break;
         case 'Y': result.show_sys = 0; break;
         case 'U': result.show_usr = 0; break;
         case 'M': result.show_rss = 0; break;
+        case 'A': result.show_io =  0; break;
         case 'G': result.symbols =  0; break;
         case 'O': result.optimize = 0; break;
         case 'D': result.macro =    0; break;
+        case 'N': result.narrow =   0; break;
+        case 'L': result.memo =     0; break;
+        case 'K': result.keep_going = 0; break;
         default:
             die_msg ("Unknown option: %c", optopt);
     } ARGEND;
 
     if (argc)
         result.fname = ev::path (*argv);
+    if (argc > 1)
+        result.input = ev::path (argv[1]);
 
     return result;
 }
 
-std::pair <int, ev::time> exec_cc (std::vector <std::string> args) {
-    char **c_vec_args = (char **)malloc ((args.size () + 1) * sizeof (char *));
-    for (size_t i = 0; i < args.size (); ++i) {
-        c_vec_args[i] = strdup (args[i].c_str ());
+/* Exit code of a compile; a compiler killed by a signal did not succeed */
+int cc_status (int status) {
+    return WIFEXITED (status) ? WEXITSTATUS (status) : 128 + WTERMSIG (status);
+}
+
+std::pair <int, ev::time> exec_cc (const std::vector <std::string>& args) {
+    auto ret = ev::spawn_wait (args);
+    return std::make_pair (cc_status (ret.status), ret.wall);
+}
+
+namespace {
+
+/* Groups of the compiles in flight, for kill_cc_groups */
+volatile sig_atomic_t cc_groups[2];
+
+/* They are outside the terminal's group: Ctrl-C would leave them running */
+void kill_cc_groups (int sig) {
+    for (auto pgid: cc_groups)
+        if (pgid > 0)
+            kill (-pgid, SIGKILL);
+    signal (sig, SIG_DFL);
+    raise (sig);
+}
+
+/* Block until one of the two has exited, without reaping it */
+void wait_either (const ev::process& a, const ev::process& b) {
+    struct pollfd fds[2] = {
+        { (int)syscall (SYS_pidfd_open, a.pid, 0), POLLIN, 0 },
+        { (int)syscall (SYS_pidfd_open, b.pid, 0), POLLIN, 0 },
+    };
+    int err = fds[0].fd < 0 || fds[1].fd < 0 ? errno : 0;
+    while (!err && poll (fds, 2, -1) < 0)
+        if (errno != EINTR)
+            err = errno;
+    for (auto& p: fds)
+        if (p.fd >= 0)
+            close (p.fd);
+    if (err)
+        throw std::runtime_error (std::string ("waiting for the compilers: ") + strerror (err));
+}
+
+} // namespace
+
+/*
+ * Run the build and a syntax-only pass side by side. Diagnostics are
+ * held back in memfds and only those of the pass that decides the result
+ * are shown: the syntax pass if it fails, which also cancels the build,
+ * else the build's own.
+ */
+std::pair <int, ev::time> exec_cc_checked (const std::vector <std::string>& args,
+                                           const std::vector <std::string>& check_args) {
+    int full_err = memfd_create ("evx-cc", MFD_CLOEXEC),
+        check_err = memfd_create ("evx-cc-check", MFD_CLOEXEC);
+    if (full_err < 0 || check_err < 0)
+        throw std::runtime_error (std::string ("memfd_create: ") + strerror (errno));
+
+    /* not sendfile: it refuses an O_APPEND stderr */
+    auto dump = [] (int fd) {
+        char buf[EV_BUFSIZE];
+        ssize_t n;
+        for (off_t off = 0; (n = pread (fd, buf, sizeof (buf), off)) > 0; off += n)
+            if (write (STDERR_FILENO, buf, n) != n)
+                break;
+    };
+
+    static const int fatal[] = { SIGINT, SIGTERM, SIGHUP };
+    struct sigaction sa = {}, old[3];
+    sa.sa_handler = kill_cc_groups;
+    for (int i = 0; i < 3; ++i)
+        sigaction (fatal[i], &sa, &old[i]);
+    auto finish = [&] (const ev::exit_info& ret, int shown) {
+        cc_groups[0] = cc_groups[1] = 0;
+        for (int i = 0; i < 3; ++i)
+            sigaction (fatal[i], &old[i], nullptr);
+        dump (shown);
+        close (full_err);
+        close (check_err);
+        return std::make_pair (cc_status (ret.status), ret.wall);
+    };
+
+    /* compilers run in their own groups: cc1plus must die with the driver */
+    ev::spawn_attr attr;
+    attr.new_pgrp = true;
+    attr.fd_err = full_err;
+    ev::process full = ev::spawn (args, attr);
+    cc_groups[0] = full.pid;
+    attr.fd_err = check_err;
+    ev::process check;
+    try {
+        check = ev::spawn (check_args, attr);
+        cc_groups[1] = check.pid;
+    }
+    catch (std::runtime_error&) {
+        return finish (full.wait (), full_err);
     }
-    c_vec_args[args.size ()] = (char *)NULL;
 
-    pid_t pid = fork ();
-    ev::time start = ev::time::now ();
-    if (pid < 0)
-        ev::die_errno ("fork ()", errno);
+    wait_either (full, check);
+    siginfo_t info = {};
+    waitid (P_PID, check.pid, &info, WEXITED | WNOHANG | WNOWAIT);
 
-    else if (pid == 0) {
-        execvp (c_vec_args[0], c_vec_args);
-        ev::die_errno ("execvp", errno);
+    if (info.si_pid == check.pid) {
+        auto check_ret = check.wait ();
+        if (WIFEXITED (check_ret.status) && WEXITSTATUS (check_ret.status) != 0) {
+            full.kill_group (SIGKILL);
+            full.wait ();
+            ev::log (LOG_INFO, "syntax check failed in %.3lfs, build cancelled",
+                     check_ret.wall.to_sec ());
+            return finish (check_ret, check_err);
+        }
+        return finish (full.wait (), full_err);
     }
-    else {
-        for (size_t i = 0; i < args.size (); ++i)
-            free (c_vec_args[i]);
-        free (c_vec_args);
 
-        int wstatus;
-        waitpid (pid, &wstatus, 0);
-        ev::time end = ev::time::now ();
-        return std::make_pair (WEXITSTATUS (wstatus), end - start);
+    auto ret = full.wait ();
+    check.kill_group (SIGKILL);
+    check.wait ();
+    return finish (ret, full_err);
+}
+
+/* Same compiler and flags as sub_args, without outputs or optimization */
+std::vector <std::string> syntax_args (ev::repo::conf_t& conf, ev::file_record rec, cmd_options opts) {
+    opts.optimize = opts.symbols = false;
+    auto full = sub_args (conf, rec, opts);
+
+    std::vector <std::string> res;
+    for (size_t i = 0; i < full.size (); ++i) {
+        if (full[i] == "-o" || full[i] == "-MF")
+            ++i;
+        else if (full[i] != "-MMD")
+            res.push_back (full[i]);
     }
+    res.push_back (EV_BUILD_SYNTAX);
+    if (isatty (STDERR_FILENO))
+        res.push_back ("-fdiagnostics-color=always");
+    return res;
+}
 
-    return {}; /* Never reached: execvp does not return on success */
+/* Only optimized builds are slow enough to be worth a second compiler */
+bool syntax_check (ev::repo::conf_t& conf, cmd_options opts) {
+    auto it = conf.find ("syntax_check");
+    return opts.optimize && (it == conf.end () || (it->second != "0" && !it->second.empty ()));
 }
 
 
@@ -187,7 +449,10 @@ std::vector <std::string> sub_args (ev::repo::conf_t& conf, ev::file_record rec,
 
     res.push_back (rec.filename.str ());
     res.push_back ("-o");
-    res.push_back (rec.exec_filename.str ());
+    res.push_back (exec_output (conf, rec).str ());
+    res.push_back ("-MMD");
+    res.push_back ("-MF");
+    res.push_back (depfile_name (conf, rec).str ());
 
     if (opts.symbols)
         res.push_back (EV_BUILD_SYMBOLS);
@@ -195,9 +460,13 @@ std::vector <std::string> sub_args (ev::repo::conf_t& conf, ev::file_record rec,
         res.push_back (EV_BUILD_OPTIMIZE);
     if (opts.macro)
         res.push_back (EV_BUILD_MACRO);
+    if (opts.narrow) {
+        res.push_back ("-I");
+        res.push_back (narrow_dir (rec).str ());
+    }
 
     for (auto kv: conf) {
-        if (kv.first == "toolchain")
+        if (is_ev_key (kv.first))
             continue;
 
         /* split string by space */
@@ -212,17 +481,236 @@ std::vector <std::string> sub_args (ev::repo::conf_t& conf, ev::file_record rec,
     return res;
 }
 
-int prep (ev::path filename) {
+bool is_ev_key (const std::string& key) {
+    for (const char **k = EV_CONF_KEYS; *k; ++k)
+        if (key == *k)
+            return true;
+    return false;
+}
+
+/* Numeric conf value, def if unset; garbage is an error, not a zero */
+double conf_number (ev::repo::conf_t& conf, const char *key, double def) {
+    auto it = conf.find (key);
+    if (it == conf.end ())
+        return def;
+    char *end;
+    errno = 0;
+    double res = strtod (it->second.c_str (), &end);
+    if (end == it->second.c_str () || *end != '\0' || errno != 0)
+        throw std::runtime_error (std::string ("bad ") + key + ": " + it->second);
+    return res;
+}
+
+bool mem_exec (ev::repo::conf_t& conf) {
+    auto it = conf.find ("memexec");
+    return it != conf.end () && it->second != "0" && !it->second.empty ();
+}
+
+/*
+ * With memexec the compiler writes to a per-user tmpfs directory, which
+ * survives between invocations but not reboots; .evd gets a copy only
+ * when asked for by show.
+ */
+ev::path exec_output (ev::repo::conf_t& conf, const ev::file_record& rec) {
+    if (!mem_exec (conf))
+        return rec.exec_filename;
+
+    ev::path dir (std::string (EV_MEM_DIR) + "-" + std::to_string (getuid ()));
+    if (::mkdir (dir.c_str (), 0700) != 0 && errno != EEXIST)
+        throw std::runtime_error (dir.str () + ": " + strerror (errno));
+
+    /* /dev/shm is shared: anyone could have made the name first */
+    struct stat st;
+    if (lstat (dir.c_str (), &st) != 0 || !S_ISDIR (st.st_mode) ||
+        st.st_uid != getuid () || (st.st_mode & 07777) != 0700) {
+        static bool warned = false;
+        if (!warned)
+            ev::log (LOG_WARN, "%s is not a private directory, building to .evd", dir.c_str ());
+        warned = true;
+        return rec.exec_filename;
+    }
+
+    std::string name = ev::n2hex (ev::fnv1a (rec.exec_filename.str ()));
+    return dir / ev::path (name);
+}
+
+ev::path depfile_name (ev::repo::conf_t& conf, const ev::file_record& rec) {
+    return ev::path (exec_output (conf, rec).str () + ".d");
+}
+
+/* Parse the rule written by -MMD: "target: dep dep \<newline> dep ..." */
+std::vector <ev::path> read_depfile (ev::path depfile, ev::path source) {
+    std::ifstream is (depfile.str ());
+    std::string text ((std::istreambuf_iterator <char> (is)), std::istreambuf_iterator <char> ());
+
+    std::vector <ev::path> res;
+    size_t colon = text.find (": ");
+    if (colon == std::string::npos)
+        return res;
+
+    std::string cur;
+    auto flush = [&res, &cur, &source] () {
+        if (!cur.empty ()) {
+            ev::path dep (cur);
+            if (dep.exists ())
+                dep = dep.absolute ();
+            if (dep.str () != source.str ())
+                res.push_back (dep);
+        }
+        cur.clear ();
+    };
+
+    for (size_t i = colon + 2; i < text.size (); ++i) {
+        char c = text[i];
+        if (c == '\\' && i + 1 < text.size ()) {
+            char next = text[i + 1];
+            if (next == '\n') {
+                flush ();
+                ++i;
+                continue;
+            }
+            if (next == ' ' || next == '#' || next == '\\') {
+                cur += next;
+                ++i;
+                continue;
+            }
+        }
+        if (c == '$' && i + 1 < text.size () && text[i + 1] == '$') {
+            cur += '$';
+            ++i;
+            continue;
+        }
+        if (std::isspace (c))
+            flush ();
+        else
+            cur += c;
+    }
+    flush ();
+
+    return res;
+}
+
+ev::path narrow_dir (const ev::file_record& rec) {
+    return ev::path (rec.exec_filename.str () + ".min");
+}
+
+/*
+ * The source and its local headers, by real path: the deps of the last
+ * build and whatever #include "..." reaches now.
+ */
+std::map <std::string, std::string> local_sources (const ev::file_record& rec) {
+    std::map <std::string, std::string> res;
+    std::vector <ev::path> todo = { rec.filename };
+    for (auto& dep: rec.deps)
+        todo.push_back (dep.first);
+    while (!todo.empty ()) {
+        char buf[PATH_MAX];
+        ev::path cur = todo.back ();
+        todo.pop_back ();
+        if (!realpath (cur.c_str (), buf) || res.count (buf))
+            continue;
+
+        std::string& src = res[buf] = ev::read_file (cur);
+        for (auto& name: ev::local_includes (src)) {
+            ev::path inc (name);
+            todo.push_back (inc.is_absolute () ? inc : cur.dirname () / inc);
+        }
+    }
+    return res;
+}
+
+/*
+ * Shadow bits/stdc++.h with one that includes only what the source and
+ * its local headers use: -I directories are searched before the system
+ * ones. The file is rewritten only when the list changes so it does not
+ * look like a modified dependency.
+ */
+size_t write_narrow_header (const ev::file_record& rec) {
+    std::set <std::string> headers;
+    for (auto& src: local_sources (rec))
+        for (auto& header: ev::needed_headers (src.second))
+            headers.insert (header);
+
+    std::string text = "#pragma once\n";
+    for (auto& header: headers)
+        text += "#include <" + header + ">\n";
+
+    ev::path dir = narrow_dir (rec);
+    ev::path bits = dir / ev::path ("bits");
+    ev::path shadow = bits / ev::path ("stdc++.h");
+    if (shadow.exists () && ev::read_file (shadow) == text)
+        return headers.size ();
+
+    for (auto& d: { dir, bits })
+        if (::mkdir (d.c_str (), 0755) != 0 && errno != EEXIST)
+            throw std::runtime_error (d.str () + ": " + strerror (errno));
+
+    std::ofstream os (shadow.str ());
+    os << text;
+    return headers.size ();
+}
+
+int prep (ev::path filename, cmd_options opts) {
+    if (filename.exists () && opts.narrow) {
+        /* Replace bits/stdc++.h by the headers the source needs */
+        std::string src = ev::read_file (filename);
+        auto have = ev::included_headers (src);
+        std::string block;
+        for (auto& header: ev::needed_headers (src))
+            if (std::find (have.begin (), have.end (), header) == have.end ())
+                block += "#include <" + header + ">\n";
+
+        const std::string bits = "#include <bits/stdc++.h>\n";
+        size_t pos = src.find (bits);
+        if (pos == std::string::npos) {
+            ev::log (LOG_WARN, "no bits/stdc++.h include");
+            return 1;
+        }
+        src.replace (pos, bits.size (), block);
+
+        std::ofstream os (filename.str ());
+        os << src;
+        ev::log (LOG_INFO, "rewrite: ok");
+        return 0;
+    }
+
     if (filename.exists ()) {
         ev::log (LOG_WARN, "file exists");
         return 1;
     }
+    std::string text = find_template (opts.tmpl);
     std::ofstream os (filename.str ());
-    os << EV_CC_TEMPLATE;
+    os << text;
     ev::log (LOG_INFO, "write: ok");
     return 0;
 }
 
+std::map <std::string, std::string> builtin_templates () {
+    return {
+        { "default", EV_CC_TEMPLATE },
+        { "fastio",  std::string ("#include <bits/stdc++.h>\n") + EV_FASTIO_KERNEL +
+                     "\n" + EV_CC_TEMPLATE_FASTIO_MAIN },
+    };
+}
+
+/* .evd/templates/<name> if there is a repo and it has one, else built in */
+std::string find_template (const std::string& name) {
+    try {
+        ev::path file = ev::repo ().get_dir () / ev::REPO_TEMPLATES / ev::path (name);
+        if (file.exists ())
+            return ev::read_file (file);
+    }
+    catch (std::runtime_error&) {
+        /* no repo: prep works anywhere */
+    }
+
+    auto builtin = builtin_templates ();
+    auto it = builtin.find (name);
+    if (it == builtin.end ())
+        throw std::runtime_error ("no template " + name);
+    return it->second;
+}
+
 int build (ev::path filename, cmd_options opts) {
     auto r = ev::repo ();
     if (!r.exists (filename)) {
@@ -234,13 +722,30 @@ int build (ev::path filename, cmd_options opts) {
     need_compile |= r[filename].mod_time_from_disk () == ev::time ();
     need_compile |= r[filename].mod_time == ev::time ();
     need_compile |= r[filename].mod_time < r[filename].mod_time_from_disk ();
+    need_compile |= !exec_output (r.get_conf (), r[filename]).exists ();
+    need_compile = need_compile || r[filename].deps_changed ();
 
     if (need_compile) {
+        size_t narrow_cnt = opts.narrow ? write_narrow_header (r[filename]) : 0;
         auto args = sub_args (r.get_conf (), r[filename], opts);
-        auto ret = exec_cc (args);
+        bool checked = syntax_check (r.get_conf (), opts);
+        if (checked && isatty (STDERR_FILENO))
+            args.push_back ("-fdiagnostics-color=always");
+        auto ret = checked ? exec_cc_checked (args, syntax_args (r.get_conf (), r[filename], opts))
+                           : exec_cc (args);
+        ev::metric ("build")
+            .add ("file", filename.str ())
+            .add ("cached", false)
+            .add ("syntax_check", checked)
+            .add ("status", ret.first)
+            .add ("wall", ret.second.to_sec ())
+            .add ("narrow", opts.narrow)
+            .add ("args", args);
         if (ret.first == 0) {
             ev::log (LOG_INFO, "built in %.3lfs", ret.second.to_sec ());
+            report_narrow (r[filename], opts, narrow_cnt, ret.second);
             r[filename].mod_time = r[filename].mod_time_from_disk ();
+            r[filename].set_deps (read_depfile (depfile_name (r.get_conf (), r[filename]), filename));
         }
         else
             ev::log (LOG_ERR, "build failed");
@@ -249,21 +754,556 @@ int build (ev::path filename, cmd_options opts) {
     }
     else {
         ev::log (LOG_INFO, "src untouched");
+        ev::metric ("build")
+            .add ("file", filename.str ())
+            .add ("cached", true)
+            .add ("status", 0);
         return 0;
     }
 }
 
+/* Keep the last compile time of either kind to show what narrowing saves */
+void report_narrow (ev::file_record& rec, cmd_options opts, size_t cnt, ev::time took) {
+    if (!opts.narrow) {
+        rec.cc_time_full = took;
+        return;
+    }
+
+    rec.cc_time_narrow = took;
+    if (rec.cc_time_full == ev::time ())
+        ev::log (LOG_INFO, "narrowed to %zu headers", cnt);
+    else
+        ev::log (LOG_INFO, "narrowed to %zu headers: %.3lfs vs %.3lfs full (%+.0lf%%)", cnt,
+                 took.to_sec (), rec.cc_time_full.to_sec (),
+                 100.0 * (took.to_sec () - rec.cc_time_full.to_sec ()) / rec.cc_time_full.to_sec ());
+}
+
+ev::path inspect_dir (const ev::file_record& rec) {
+    return ev::path (rec.exec_filename.str () + ".insp");
+}
+
+/*
+ * Compile to assembly with optimization remarks. Both outputs are kept
+ * under a key of the source, its local headers and the arguments, so
+ * inspecting an unchanged source again costs no compile; only the
+ * latest key is kept.
+ */
+int inspect (ev::path filename, cmd_options opts) {
+    auto r = ev::repo ();
+    if (!r.exists (filename))
+        r.emplace (filename);
+    ev::file_record& rec = r[filename];
+    auto& conf = r.get_conf ();
+
+    opts.symbols = opts.optimize = true;
+    auto toolchain = conf.find ("toolchain");
+    bool clang = toolchain != conf.end () && toolchain->second.find ("clang") != std::string::npos;
+
+    std::string source_text = ev::read_file (filename);
+    if (opts.narrow)
+        write_narrow_header (rec);
+    auto build_args = sub_args (conf, rec, opts);
+    std::string key_text;
+    for (auto& src: local_sources (rec))
+        key_text += src.first + '\0' + src.second + '\0';
+    for (auto& arg: build_args)
+        key_text += '\0' + arg;
+
+    ev::path dir = inspect_dir (rec);
+    if (::mkdir (dir.c_str (), 0755) != 0 && errno != EEXIST)
+        throw std::runtime_error (dir.str () + ": " + strerror (errno));
+    std::string key = ev::n2hex (ev::fnv1a (key_text));
+    ev::path asm_file = dir / ev::path (key + ".s"),
+             opt_file = dir / ev::path (key + ".opt");
+
+    if (asm_file.exists () && opt_file.exists ())
+        ev::log (LOG_INFO, "inspect cached");
+    else {
+        std::vector <std::string> args;
+        for (size_t i = 0; i < build_args.size (); ++i) {
+            if (build_args[i] == "-MMD")
+                continue;
+            else if (build_args[i] == "-MF")
+                ++i;
+            else if (build_args[i] == "-o") {
+                args.push_back ("-o");
+                args.push_back (asm_file.str ());
+                ++i;
+            }
+            else
+                args.push_back (build_args[i]);
+        }
+        args.push_back ("-S");
+
+        ev::spawn_attr attr;
+        if (clang) {
+            for (const char **flag = EV_INSPECT_CLANG; *flag; ++flag)
+                args.push_back (*flag);
+            attr.fd_err = open (opt_file.c_str (), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (attr.fd_err < 0)
+                ev::die_errno (opt_file.c_str (), errno);
+        }
+        else
+            args.push_back (EV_INSPECT_GCC + opt_file.str ());
+
+        auto ret = ev::spawn_wait (args, attr);
+        if (attr.fd_err >= 0)
+            close (attr.fd_err);
+        if (cc_status (ret.status) != 0) {
+            if (clang)
+                std::cerr << ev::read_file (opt_file);
+            unlink (asm_file.c_str ());
+            unlink (opt_file.c_str ());
+            ev::log (LOG_ERR, "build failed");
+            return cc_status (ret.status);
+        }
+        ev::log (LOG_INFO, "inspected in %.3lfs", ret.wall.to_sec ());
+
+        /* Older keys are dead: the source or the flags have moved on */
+        if (DIR *d = opendir (dir.c_str ())) {
+            while (struct dirent *ent = readdir (d)) {
+                std::string name = ent->d_name;
+                if (name[0] != '.' && name.compare (0, key.size () + 1, key + ".") != 0)
+                    unlinkat (dirfd (d), ent->d_name, 0);
+            }
+            closedir (d);
+        }
+    }
+
+    auto remarks = ev::parse_remarks (ev::read_file (opt_file), filename.str ());
+    ev::metric m ("inspect");
+    m.add ("file", filename.str ()).add ("remarks", remarks.size ());
+    for (const char *kind: { "vec", "novec", "inline", "noinline" })
+        m.add (kind, (size_t)std::count_if (remarks.begin (), remarks.end (),
+                                            [kind] (const ev::opt_remark& rem) { return rem.kind == kind; }));
+    ev::print_remarks (std::cout, remarks, source_text);
+
+    if (!opts.function.empty ()) {
+        std::cout << std::endl;
+        if (!ev::annotate_asm (std::cout, ev::read_file (asm_file), opts.function,
+                               filename.str (), source_text)) {
+            ev::log (LOG_ERR, "no function matching %s", opts.function.c_str ());
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Checkers and generators: built like any source, but always optimized */
+int build_helper (ev::path src, cmd_options opts) {
+    opts.optimize = true;
+    opts.macro = opts.narrow = false;
+    int ret = build (src, opts);
+    if (ret != 0)
+        ev::log (LOG_ERR, "%s: build failed", src.c_str ());
+    return ret;
+}
+
+/*
+ * Generated inputs are cached by the generator's executable contents and
+ * arguments, so rebuilding an unchanged generator keeps its inputs.
+ */
+void set_gen_key (ev::test_case& tc, ev::path gen_exec) {
+    static std::map <ev::path, uint64_t> exec_hash;
+    if (exec_hash.find (gen_exec) == exec_hash.end ())
+        exec_hash[gen_exec] = ev::fnv1a (ev::read_file (gen_exec));
+
+    uint64_t key = exec_hash[gen_exec];
+    for (auto& arg: tc.gen)
+        key = ev::fnv1a (arg.c_str (), arg.size () + 1, key);
+    tc.gen.insert (tc.gen.begin (), gen_exec.str ());
+    tc.gen_key = key;
+}
+
+/*
+ * Part of a memoized result's key shared by all tests of a run: what is
+ * executed and how. Tests add their input and answer.
+ */
+uint64_t memo_key (const ev::test_setup& setup, const std::string& env_desc) {
+    uint64_t key = ev::fnv1a (ev::read_file (ev::path (setup.solution[0])));
+    if (!setup.checker.empty ()) {
+        std::string checker = ev::read_file (ev::path (setup.checker[0]));
+        key = ev::fnv1a (checker.data (), checker.size (), key);
+    }
+    key = ev::fnv1a (env_desc.c_str (), env_desc.size () + 1, key);
+    key = ev::fnv1a (&setup.time_scale, sizeof (setup.time_scale), key);
+    return ev::fnv1a (&setup.time_limit, sizeof (setup.time_limit), key);
+}
+
+/* Paths in records are relative to the source */
+ev::path record_path (const ev::file_record& rec, const std::string& rel) {
+    ev::path p (rel);
+    return p.is_absolute () ? p : rec.filename.dirname () / p;
+}
+
+/* The record's tests key, else <source without extension>.tests */
+ev::path tests_dir (const ev::file_record& rec) {
+    if (!rec.tests.empty ())
+        return record_path (rec, rec.tests);
+    std::string src = rec.filename.str ();
+    size_t dot = src.rfind ('.');
+    if (dot != std::string::npos && dot > src.rfind ('/'))
+        src.erase (dot);
+    return ev::path (src + ".tests");
+}
+
+/*
+ * How tests and reductions run the target: its executable, the record's
+ * checker (already built), env profile, time limit and jobs from conf.
+ */
+ev::test_setup solution_setup (ev::repo& r, ev::path filename, ev::path checker, cmd_options opts,
+                               std::string *env) {
+    auto& conf = r.get_conf ();
+    ev::file_record& rec = r[filename];
+
+    ev::test_setup setup;
+    ev::path exec = exec_output (conf, rec);
+    setup.solution = { exec.str () };
+    setup.solution_fd = open (exec.c_str (), O_RDONLY | O_CLOEXEC);
+    if (setup.solution_fd < 0)
+        ev::die_errno (exec.c_str (), errno);
+    if (!checker.str ().empty ())
+        setup.checker = { exec_output (conf, r[checker]).str () };
+
+    *env = env_name (conf, rec, opts);
+    if (!env->empty ())
+        ev::apply_env (r.get_env (*env), setup.attr);
+    setup.time_limit = conf_number (conf, "time_limit", 0);
+    if (!(setup.time_limit >= 0 && setup.time_limit < 1e6))
+        throw std::runtime_error ("bad time_limit: " + conf["time_limit"]);
+    setup.time_scale = judge_scale (r);
+    double jobs = conf_number (conf, "jobs", std::max (1u, std::thread::hardware_concurrency ()));
+    if (!(jobs >= 1 && jobs <= 4096) || jobs != (int)jobs)
+        throw std::runtime_error ("bad jobs: " + conf["jobs"]);
+    setup.jobs = jobs;
+    return setup;
+}
+
+/*
+ * Run the target on every test of its tests dir. A checker named by the
+ * record is built like any other source, so it is compiled once and
+ * then reused from its own record.
+ */
+int test (ev::path filename, cmd_options opts) {
+    ev::path checker, dir;
+    std::vector <ev::test_case> tests;
+    {
+        auto r = ev::repo ();
+        if (!r[filename].checker.empty ())
+            checker = record_path (r[filename], r[filename].checker).absolute ();
+        dir = tests_dir (r[filename]);
+        tests = ev::find_tests (dir);
+    }
+    if (tests.empty ()) {
+        ev::log (LOG_ERR, "no tests in %s", dir.c_str ());
+        return 1;
+    }
+
+    std::set <ev::path> helpers;
+    if (!checker.str ().empty ())
+        helpers.insert (checker);
+    bool generated = false;
+    for (auto& tc: tests)
+        if (!tc.generator.str ().empty ()) {
+            tc.generator = tc.generator.absolute ();
+            helpers.insert (tc.generator);
+            generated = true;
+        }
+    for (auto& src: helpers)
+        if (build_helper (src, opts) != 0)
+            return 1;
+
+    auto r = ev::repo ();
+    auto& conf = r.get_conf ();
+    ev::file_record& rec = r[filename];
+
+    std::string env;
+    ev::test_setup setup = solution_setup (r, filename, checker, opts, &env);
+
+    /* -L still records what it ran, for the next -l */
+    ev::result_memo memo (r.get_dir () / EV_RESULTS_FILE);
+    setup.memo = &memo;
+    setup.memo_key = memo_key (setup, env.empty () ? "" : env + ev::describe_env (r.get_env (env)));
+    setup.reuse = opts.memo;
+    setup.fail_fast = !opts.keep_going;
+
+    std::unique_ptr <ev::input_cache> inputs;
+    if (generated) {
+        auto tool = conf.find ("compress");
+        auto budget = conf.find ("input_cache");
+        inputs.reset (new ev::input_cache (
+            r.get_dir () / ev::path ("inputs"),
+            tool == conf.end () ? ev::input_cache::default_tool () : tool->second,
+            budget == conf.end () ? EV_INPUT_CACHE_BUDGET : ev::parse_size (budget->second)));
+        setup.inputs = inputs.get ();
+    }
+    for (auto& tc: tests)
+        if (!tc.generator.str ().empty ())
+            set_gen_key (tc, exec_output (conf, r[tc.generator]));
+
+    for (auto& tc: tests) {
+        auto h = rec.runs.find (tc.name);
+        if (h != rec.runs.end ()) {
+            tc.failed_last = h->second.failed;
+            tc.last_cpu = h->second.cpu;
+        }
+    }
+    ev::order_tests (tests, setup.time_limit / setup.time_scale);
+
+    ev::time start = ev::time::monotonic ();
+    auto results = ev::run_tests (setup, tests, [&opts, &setup] (const ev::test_result& res) {
+        report_test (res, opts, setup.time_scale);
+    });
+    ev::time wall = ev::time::monotonic () - start;
+    close (setup.solution_fd);
+    if (inputs)
+        inputs->evict ();
+
+    /* Tests gone from the dir are forgotten, ones skipped keep their history */
+    std::map <std::string, ev::test_history> runs;
+    for (auto& tc: tests)
+        if (rec.runs.find (tc.name) != rec.runs.end ())
+            runs[tc.name] = rec.runs[tc.name];
+    for (auto& res: results)
+        runs[res.test.name] = { res.v != ev::V_OK, res.cpu () };
+    rec.runs = runs;
+
+    size_t passed = 0, memoized = 0;
+    const ev::test_result *slowest = NULL;
+    double check_time = 0;
+    for (auto& res: results) {
+        passed += res.v == ev::V_OK;
+        memoized += res.memoized;
+        if (!slowest || res.cpu () > slowest->cpu ())
+            slowest = &res;
+        check_time += res.checked && !res.memoized ? res.check.wall.to_sec () : 0;
+    }
+
+    char judge[48] = "";
+    if (setup.time_scale != 1)
+        snprintf (judge, sizeof (judge), ", judge ~%.3lfs", slowest->cpu () * setup.time_scale);
+    ev::log (passed == results.size () ? LOG_WARN : LOG_ERR,
+             "passed %zu/%zu, max %.3lfs (%s)%s%s", passed, results.size (),
+             slowest->cpu (), slowest->test.name.c_str (), judge,
+             env.empty () ? "" : (", env " + env).c_str ());
+    if (!setup.checker.empty ())
+        ev::log (LOG_INFO, "checker: %.3lfs total", check_time);
+    if (memoized)
+        ev::log (LOG_INFO, "%zu/%zu memoized, -L to rerun", memoized, results.size ());
+    if (results.size () < tests.size ())
+        ev::log (LOG_INFO, "stopped at first failure, %zu tests not run", tests.size () - results.size ());
+
+    ev::metric ("tests")
+        .add ("file", filename.str ())
+        .add ("total", tests.size ())
+        .add ("ran", results.size ())
+        .add ("passed", passed)
+        .add ("memoized", memoized)
+        .add ("max_cpu", slowest->cpu ())
+        .add ("judge_ratio", setup.time_scale)
+        .add ("check_wall", check_time)
+        .add ("wall", wall.to_sec ())
+        .add ("env", env);
+
+    return passed == results.size () ? 0 : 1;
+}
+
+/*
+ * Shrink opts.input while the target keeps failing on it with the same
+ * verdict. With a reference solution in the record its output is the
+ * answer, and inputs it fails on do not count; without one only crashes
+ * and timeouts can be reduced.
+ */
+int reduce (ev::path filename, cmd_options opts) {
+    if (opts.input.str ().empty ()) {
+        ev::log (LOG_ERR, "missing input to reduce");
+        return 1;
+    }
+    std::string input = ev::read_file (opts.input);
+
+    ev::path checker, reference;
+    {
+        auto r = ev::repo ();
+        ev::file_record& rec = r[filename];
+        if (!rec.checker.empty ())
+            checker = record_path (rec, rec.checker).absolute ();
+        if (!rec.reference.empty ())
+            reference = record_path (rec, rec.reference).absolute ();
+    }
+    for (auto& src: { checker, reference })
+        if (!src.str ().empty () && build_helper (src, opts) != 0)
+            return 1;
+
+    auto r = ev::repo ();
+    std::string env;
+    ev::test_setup setup = solution_setup (r, filename, checker, opts, &env);
+    std::vector <std::string> ref;
+    if (!reference.str ().empty ())
+        ref = { exec_output (r.get_conf (), r[reference]).str () };
+
+    auto verdict_of = [&setup, &ref] (const std::string& text) {
+        ev::memfile in ("evx-reduce"), ans ("evx-reduce-ans");
+        in.append (text);
+
+        ev::test_case tc;
+        tc.name = "reduce";
+        tc.input = ev::path (in.proc_path ());
+        if (!ref.empty ()) {
+            ev::spawn_attr attr;
+            attr.fd_in = open (tc.input.c_str (), O_RDONLY | O_CLOEXEC);
+            attr.fd_out = ans.fd ();
+            attr.fd_err = open ("/dev/null", O_WRONLY | O_CLOEXEC);
+            int status = -1;
+            try {
+                status = ev::spawn_wait (ref, attr).status;
+            }
+            catch (std::runtime_error&) {}
+            close (attr.fd_in);
+            close (attr.fd_err);
+            if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+                return ev::V_FAIL;
+            tc.answer = ev::path (ans.proc_path ());
+        }
+        return ev::run_test (setup, tc).v;
+    };
+
+    ev::verdict orig = verdict_of (input);
+    if (orig == ev::V_OK || orig == ev::V_FAIL) {
+        ev::log (LOG_ERR, "%s", orig == ev::V_OK ? "target does not fail on input"
+                                                 : "reference or checker fails on input");
+        close (setup.solution_fd);
+        return 1;
+    }
+    ev::log (LOG_INFO, "reducing %s (%s) on %d jobs", opts.input.c_str (), ev::verdict_name (orig),
+             setup.jobs);
+
+    ev::reduce_stats stats;
+    ev::time start = ev::time::monotonic ();
+    std::string res = ev::reduce_input (input, [&verdict_of, orig] (const std::string& text) {
+        return verdict_of (text) == orig;
+    }, setup.jobs, &stats);
+    ev::time took = ev::time::monotonic () - start;
+    close (setup.solution_fd);
+
+    ev::path out (opts.input.str () + ".min");
+    {
+        std::ofstream os (out.str ());
+        os << res;
+    }
+    ev::log (LOG_WARN, "%s: %zu -> %zu lines, %zu tokens, %zu bytes%s", out.c_str (),
+             stats.lines_before, stats.lines_after, stats.tokens_after, res.size (),
+             stats.header ? " (header counts kept in sync)" : "");
+    ev::log (LOG_INFO, "%zu runs in %.3lfs", stats.tests, took.to_sec ());
+
+    ev::metric ("reduce")
+        .add ("file", filename.str ())
+        .add ("input", opts.input.str ())
+        .add ("verdict", ev::verdict_name (orig))
+        .add ("bytes_before", input.size ())
+        .add ("bytes_after", res.size ())
+        .add ("runs", stats.tests)
+        .add ("wall", took.to_sec ())
+        .add ("env", env);
+    return 0;
+}
+
+void report_test (const ev::test_result& res, cmd_options opts, double judge) {
+    char scaled[32] = "", check[48] = "";
+    if (judge != 1)
+        snprintf (scaled, sizeof (scaled), " (judge ~%.3lfs)", res.cpu () * judge);
+    if (res.memoized)
+        snprintf (check, sizeof (check), " (memo)");
+    else if (res.checked)
+        snprintf (check, sizeof (check), " (chk %.3lfs)", res.check.wall.to_sec ());
+    else if (!res.test.gen.empty ())
+        snprintf (check, sizeof (check), " (gen%s)", res.cache_hit ? ", cached" : "");
+
+    int lvl = res.v == ev::V_OK ? LOG_INFO : LOG_ERR;
+    ev::log (lvl, "%-12s %-4s %.3lfs%s%s%s%s", res.test.name.c_str (), ev::verdict_name (res.v),
+             res.cpu (), scaled, check, res.comment.empty () ? "" : ": ", res.comment.c_str ());
+    if (res.v == ev::V_RE)
+        report_signal (res.run.status);
+    if (opts.show_rss)
+        ev::log (LOG_WARN, "rss: %ldK", res.run.usage.ru_maxrss);
+
+    ev::metric m ("test");
+    m.add ("input", res.test.input.str ())
+     .add ("test", res.test.name)
+     .add ("verdict", ev::verdict_name (res.v));
+    add_exit_info (m, res.run);
+    if (res.checked)
+        m.add ("check_wall", res.check.wall.to_sec ());
+    m.add ("memoized", res.memoized)
+     .add ("out_hash", ev::n2hex (res.out_hash));
+    if (!res.test.gen.empty ())
+        m.add ("generated", true).add ("cache_hit", res.cache_hit);
+    m.add ("comment", res.comment);
+}
+
+/*
+ * judge_ratio from conf, else the [judge] profile against this
+ * machine's; 1 (no scaling) without either.
+ */
+double judge_scale (ev::repo& r) {
+    auto& conf = r.get_conf ();
+    if (conf.find ("judge_ratio") != conf.end ()) {
+        double ratio = conf_number (conf, "judge_ratio", 1);
+        if (!std::isfinite (ratio) || ratio <= 0)
+            throw std::runtime_error ("bad judge_ratio: " + conf["judge_ratio"]);
+        return ratio;
+    }
+    double ratio = ev::judge_ratio (r.get_machine (), r.get_judge ());
+    return ratio > 0 ? ratio : 1;
+}
+
+/*
+ * Time the calibration kernels into [machine]. Copying that section from
+ * a judge-like box to [judge] here, or setting judge_ratio, makes every
+ * reported time show its judge equivalent.
+ */
+int calibrate () {
+    auto r = ev::repo ();
+    ev::log (LOG_INFO, "timing kernels, takes a few seconds");
+    r.get_machine () = ev::calibrate_machine ();
+    for (auto& kv: r.get_machine ())
+        ev::log (LOG_WARN, "%-10s %ss", kv.first.c_str (), kv.second.c_str ());
+
+    double ratio = ev::judge_ratio (r.get_machine (), r.get_judge ());
+    if (ratio > 0)
+        ev::log (LOG_WARN, "judge is %.2lfx this machine", ratio);
+
+    ev::metric m ("calibrate");
+    for (auto& kv: r.get_machine ())
+        m.add (kv.first.c_str (), atof (kv.second.c_str ()));
+    m.add ("judge_ratio", ratio);
+    return 0;
+}
+
 int init () {
     auto cwd = ev::path::cwd ();
-    ev::repo::create (cwd.absolute ());
+    auto r = ev::repo::create (cwd.absolute ());
+
+    /* Copies to edit or to add new ones next to */
+    ev::path dir = r.get_dir () / ev::REPO_TEMPLATES;
+    if (::mkdir (dir.c_str (), 0755) != 0)
+        throw std::runtime_error (dir.str () + ": " + strerror (errno));
+    for (auto& tmpl: builtin_templates ()) {
+        std::ofstream os ((dir / ev::path (tmpl.first)).str ());
+        os << tmpl.second;
+    }
     ev::log (LOG_INFO, "init ok");
     return 0;
 }
 
 int show (ev::path filename) {
     auto r = ev::repo ();
-    if (r.exists (filename))
-        std::cout << r[filename].exec_filename.c_str () << std::endl;
+    if (r.exists (filename)) {
+        ev::file_record& rec = r[filename];
+        ev::path out = exec_output (r.get_conf (), rec);
+        if (out.str () != rec.exec_filename.str () && out.exists ())
+            ev::copy_file (out, rec.exec_filename, 0755);
+        std::cout << rec.exec_filename.c_str () << std::endl;
+    }
     else {
         ev::log (LOG_ERR, "no such record");
         return 1;
@@ -272,45 +1312,107 @@ int show (ev::path filename) {
 }
 
 int run (ev::path filename, cmd_options opts) {
-    filename = ev::repo ()[filename].exec_filename;
-    char * args[2];
-    args[0] = const_cast <char *> (filename.c_str ());
-    args[1] = NULL;
+    auto r = ev::repo ();
+    std::string env = env_name (r.get_conf (), r[filename], opts);
+    ev::path exec = exec_output (r.get_conf (), r[filename]);
+    double judge = judge_scale (r);     /* conf errors before the run, not after */
 
-    pid_t pid = fork ();
-    if (pid < 0)
-        ev::die_errno ("fork()", errno);
+    ev::spawn_attr attr;
+    if (!env.empty ())
+        ev::apply_env (r.get_env (env), attr);
 
-    else if (pid == 0) {
-        execvp (filename.c_str (), args);
-        ev::die_errno ("execvp()", errno);
-    }
-    else {
-        int retstatus;
-        struct rusage usg;
-        wait4 (pid, &retstatus, 0, &usg);
+    /* exec through the fd: no second path lookup on slow filesystems */
+    attr.exec_fd = open (exec.c_str (), O_RDONLY | O_CLOEXEC);
+    if (attr.exec_fd < 0)
+        ev::die_errno (exec.c_str (), errno);
 
-        /* FIXME write '\n' if last char from program was not '\n' */
-        /* fprintf (stderr, "\n"); */
+    auto ret = ev::spawn_wait ({ exec.str () }, attr, true);
+    close (attr.exec_fd);
 
-        report_signal (retstatus);
-        show_usage (usg, opts);
-    }
+    /* FIXME write '\n' if last char from program was not '\n' */
+    /* fprintf (stderr, "\n"); */
+
+    report_signal (ret.status);
+    show_usage (ret.usage, opts, judge);
+    show_io (ret.io, opts);
+    if (!env.empty ())
+        ev::log (LOG_WARN, "env: %s (%s)", env.c_str (), ev::describe_env (r.get_env (env)).c_str ());
+
+    ev::metric m ("run");
+    m.add ("file", filename.str ());
+    add_exit_info (m, ret);
+    m.add ("env", env);
     return 0;
 }
 
-void show_usage (struct rusage usg, cmd_options opts) {
+/* Fields shared by every event describing a finished child */
+void add_exit_info (ev::metric& m, const ev::exit_info& ret) {
+    if (!ev::metrics_enabled ())
+        return;
+    ev::time utime (ret.usage.ru_utime.tv_sec, ret.usage.ru_utime.tv_usec * 1000);
+    ev::time stime (ret.usage.ru_stime.tv_sec, ret.usage.ru_stime.tv_usec * 1000);
+
+    m.add ("exit", WIFEXITED (ret.status) ? WEXITSTATUS (ret.status) : -1)
+     .add ("signal", WIFSIGNALED (ret.status) ? WTERMSIG (ret.status) : 0)
+     .add ("wall", ret.wall.to_sec ())
+     .add ("usr", utime.to_sec ())
+     .add ("sys", stime.to_sec ())
+     .add ("maxrss_kb", (int64_t)ret.usage.ru_maxrss);
+    if (ret.io.valid)
+        m.add ("rchar", ret.io.rchar)
+         .add ("wchar", ret.io.wchar)
+         .add ("syscr", ret.io.syscr)
+         .add ("syscw", ret.io.syscw);
+}
+
+/* -x, then the record's env, then the repo default */
+std::string env_name (ev::repo::conf_t& conf, const ev::file_record& rec, cmd_options opts) {
+    if (!opts.env.empty ())
+        return opts.env;
+    if (!rec.env.empty ())
+        return rec.env;
+    auto it = conf.find ("env");
+    return it == conf.end () ? "" : it->second;
+}
+
+void show_usage (struct rusage usg, cmd_options opts, double judge) {
         ev::time utime (usg.ru_utime.tv_sec, usg.ru_utime.tv_usec * 1000);
         ev::time stime (usg.ru_stime.tv_sec, usg.ru_stime.tv_usec * 1000);
 
-        if (opts.show_usr)
+        if (opts.show_usr && judge != 1)
+            ev::log (LOG_WARN, "usr: %.3lf (judge ~%.3lf)", utime.to_sec (), utime.to_sec () * judge);
+        else if (opts.show_usr)
             ev::log (LOG_WARN, "usr: %.3lf", utime.to_sec ());
-        if (opts.show_sys)
+        if (opts.show_sys && judge != 1)
+            ev::log (LOG_WARN, "sys: %.3lf (judge ~%.3lf)", stime.to_sec (), stime.to_sec () * judge);
+        else if (opts.show_sys)
             ev::log (LOG_WARN, "sys: %.3lf", stime.to_sec ());
         if (opts.show_rss)
             ev::log (LOG_WARN, "rss: %ldK (=%ldM)", usg.ru_maxrss, usg.ru_maxrss / 1000);
 }
 
+void show_io (const ev::io_counters& io, cmd_options opts) {
+    if (!io.valid)
+        return;
+
+    auto avg = [] (uint64_t bytes, uint64_t calls) {
+        return calls ? (double)bytes / calls : 0.0;
+    };
+    if (opts.show_io) {
+        ev::log (LOG_WARN, "rd: %llu calls, %lluK (%.0lfB/call)", (unsigned long long)io.syscr,
+                 (unsigned long long)io.rchar >> 10, avg (io.rchar, io.syscr));
+        ev::log (LOG_WARN, "wr: %llu calls, %lluK (%.0lfB/call)", (unsigned long long)io.syscw,
+                 (unsigned long long)io.wchar >> 10, avg (io.wchar, io.syscw));
+    }
+
+    if (io.syscw >= EV_SMALL_IO_CALLS && avg (io.wchar, io.syscw) < EV_SMALL_IO_BYTES)
+        ev::log (LOG_WARN, "%llu writes of %.1lfB on average: endl or unbuffered output?",
+                 (unsigned long long)io.syscw, avg (io.wchar, io.syscw));
+    if (io.syscr >= EV_SMALL_IO_CALLS && avg (io.rchar, io.syscr) < EV_SMALL_IO_BYTES)
+        ev::log (LOG_WARN, "%llu reads of %.1lfB on average: unbuffered input?",
+                 (unsigned long long)io.syscr, avg (io.rchar, io.syscr));
+}
+
 void report_signal (int retstatus) {
     if (WIFSIGNALED (retstatus)) {
         char signame[5];
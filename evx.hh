@@ -6,80 +6,127 @@
 #include <map>
 #include <vector>
 
+#include "metrics.hh"
 #include "repo.hh"
+#include "spawn.hh"
+#include "test.hh"
 #include "util.hh"
 
 #define EV_BUFSIZE 4096
 
-static const char *EV_BUILD_SYMBOLS = "-g";
-static const char *EV_BUILD_OPTIMIZE = "-O3";
-static const char *EV_BUILD_MACRO = "-D_LOCAL_SRC";
-
-static const char *EV_CC_TEMPLATE =                                              \
-    "#include <bits/stdc++.h>\n"                                                 \
-    "using namespace std;\n"                                                     \
-    "typedef long long i64;typedef unsigned long long u64;\n"                    \
-    "#ifdef _LOCAL_SRC\n"                                                        \
-    "#define db(...) fprintf (stderr, __VA_ARGS__)\n"                            \
-    "#define set_io\n"                                                           \
-    "#else\n"                                                                    \
-    "#define db(...)\n"                                                          \
-    "#define set_io {ios_base::sync_with_stdio(0);cin.tie(0);cout.tie(0);}\n"    \
-    "#endif\n\n"                                                                 \
-                                                                                 \
-    "int main () {\n"                                                            \
-    "    set_io;\n\n"                                                            \
-    "    return 0;\n"                                                            \
-    "}\n";
+/* Warn about I/O when there are this many syscalls moving less than this on average */
+#define EV_SMALL_IO_CALLS 1000
+#define EV_SMALL_IO_BYTES 64
 
+/* Default disk budget of the generated input cache */
+#define EV_INPUT_CACHE_BUDGET (1ULL << 30)
 
 void print_help (const char *argv0);
+void missing_arg (char opt);
 
 struct cmd_options {
-    ev::path fname;
+    ev::path fname,
+             input;     /* second argument, for -z */
     enum {
         CMD_UNKNOWN,
         CMD_INIT,
         CMD_PREP,
         CMD_BUILD,
         CMD_RUN,
-        CMD_SHOW
+        CMD_SHOW,
+        CMD_INSPECT,
+        CMD_TEST,
+        CMD_REDUCE,
+        CMD_CALIBRATE
     } cmd;
+    std::string function,
+                env,
+                metrics,
+                tmpl;
     bool quiet,
          show_sys,
          show_usr,
          show_rss,
+         show_io,
          symbols,
          optimize,
-         macro;
+         macro,
+         narrow,
+         memo,
+         keep_going;
 
     cmd_options ():
         fname    (),
+        input    (),
         cmd      (CMD_UNKNOWN),
+        function (),
+        env      (),
+        metrics  (),
+        tmpl     ("default"),
         quiet    (false),
         show_sys (false),
         show_usr (true),
         show_rss (false),
+        show_io  (false),
         symbols  (true),
         optimize (false),
-        macro    (true)
+        macro    (true),
+        narrow   (false),
+        memo     (true),
+        keep_going (true)
     {}
 
 };
 
 cmd_options parse_argv (int argc, char **argv);
 
-std::pair <int, ev::time> exec_cc (std::vector <std::string> args);
+int cc_status (int status);
+std::pair <int, ev::time> exec_cc (const std::vector <std::string>& args);
+std::pair <int, ev::time> exec_cc_checked (const std::vector <std::string>& args,
+                                           const std::vector <std::string>& check_args);
+std::vector <std::string> syntax_args (ev::repo::conf_t& conf, ev::file_record rec, cmd_options opts);
+bool syntax_check (ev::repo::conf_t& conf, cmd_options opts);
 std::vector <std::string> sub_args (ev::repo::conf_t& conf, ev::file_record rec, cmd_options opts);
+bool is_ev_key (const std::string& key);
+double conf_number (ev::repo::conf_t& conf, const char *key, double def);
+bool mem_exec (ev::repo::conf_t& conf);
+ev::path exec_output (ev::repo::conf_t& conf, const ev::file_record& rec);
+ev::path depfile_name (ev::repo::conf_t& conf, const ev::file_record& rec);
+std::vector <ev::path> read_depfile (ev::path depfile, ev::path source);
+ev::path narrow_dir (const ev::file_record& rec);
+ev::path inspect_dir (const ev::file_record& rec);
+std::map <std::string, std::string> local_sources (const ev::file_record& rec);
+size_t write_narrow_header (const ev::file_record& rec);
 
 int build (ev::path filename, cmd_options opts);
 int run   (ev::path filename, cmd_options opts);
+std::string env_name (ev::repo::conf_t& conf, const ev::file_record& rec, cmd_options opts);
 int show  (ev::path filename);
-int prep  (ev::path filename);
+int inspect (ev::path filename, cmd_options opts);
+int test  (ev::path filename, cmd_options opts);
+int reduce (ev::path filename, cmd_options opts);
+
+ev::test_setup solution_setup (ev::repo& r, ev::path filename, ev::path checker, cmd_options opts,
+                               std::string *env);
+ev::path record_path (const ev::file_record& rec, const std::string& rel);
+ev::path tests_dir (const ev::file_record& rec);
+void report_test (const ev::test_result& res, cmd_options opts, double judge);
+int build_helper (ev::path src, cmd_options opts);
+void set_gen_key (ev::test_case& tc, ev::path gen_exec);
+uint64_t memo_key (const ev::test_setup& setup, const std::string& env_desc);
+int prep  (ev::path filename, cmd_options opts);
 int init  ();
+int calibrate ();
+double judge_scale (ev::repo& r);
+
+std::map <std::string, std::string> builtin_templates ();
+std::string find_template (const std::string& name);
 
 void report_signal (int retstatus);
-void show_usage (struct rusage usg, cmd_options opts);
+void report_narrow (ev::file_record& rec, cmd_options opts, size_t cnt, ev::time took);
+void show_usage (struct rusage usg, cmd_options opts, double judge);
+void show_io (const ev::io_counters& io, cmd_options opts);
+void add_exit_info (ev::metric& m, const ev::exit_info& ret);
 
 std::string find_file ();
 std::string find_dir ();
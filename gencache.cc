@@ -0,0 +1,197 @@
+#include <cerrno>
+#include <cstdlib>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "gencache.hh"
+
+namespace ev {
+
+namespace {
+
+/* A <key>.<tool>.<tid> not written to for this long lost its writer */
+const time_t STALE_TMP_SEC = 600;
+
+bool in_path (const std::string& tool) {
+    const char *env = getenv ("PATH");
+    std::string path = env ? env : "/usr/bin:/bin";
+    size_t pos = 0;
+    while (pos <= path.size ()) {
+        size_t end = path.find (':', pos);
+        if (end == std::string::npos)
+            end = path.size ();
+        std::string candidate = path.substr (pos, end - pos) + "/" + tool;
+        if (::access (candidate.c_str (), X_OK) == 0)
+            return true;
+        pos = end + 1;
+    }
+    return false;
+}
+
+bool exited_ok (const exit_info& info) {
+    return WIFEXITED (info.status) && WEXITSTATUS (info.status) == 0;
+}
+
+} // namespace
+
+input_cache :: input_cache (ev::path dir_, std::string tool_, uint64_t budget_):
+    dir    (dir_),
+    tool   (tool_),
+    budget (budget_)
+{
+    if (::mkdir (dir.c_str (), 0755) != 0 && errno != EEXIST)
+        throw std::runtime_error (dir.str () + ": " + strerror (errno));
+}
+
+std::string input_cache :: default_tool () {
+    for (const char *tool: { "zstd", "lz4", "gzip" })
+        if (in_path (tool))
+            return tool;
+    throw std::runtime_error ("no compressor found (zstd, lz4, gzip)");
+}
+
+ev::path input_cache :: entry (uint64_t key) const {
+    return dir / ev::path (ev::n2hex (key) + "." + tool);
+}
+
+ev::path input_cache :: get (const std::vector <std::string>& gen, uint64_t key, bool *hit) {
+    ev::path cached = entry (key);
+    if (cached.exists ()) {
+        *hit = true;
+        utimensat (AT_FDCWD, cached.c_str (), NULL, 0);
+        return cached;
+    }
+    *hit = false;
+
+    /* gen | tool -c > tmp; rename makes concurrent misses harmless */
+    ev::path tmp (cached.str () + "." + std::to_string (gettid ()));
+    int out = open (tmp.c_str (), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0)
+        throw std::runtime_error (tmp.str () + ": " + strerror (errno));
+
+    int fds[2];
+    if (pipe2 (fds, O_CLOEXEC) != 0) {
+        close (out);
+        throw std::runtime_error (std::string ("pipe: ") + strerror (errno));
+    }
+
+    spawn_attr zattr;
+    zattr.fd_in = fds[0];
+    zattr.fd_out = out;
+    spawn_attr gattr;
+    gattr.fd_in = open ("/dev/null", O_RDONLY | O_CLOEXEC);
+    gattr.fd_out = fds[1];
+
+    exit_info zret, gret;
+    process z, g;
+    try {
+        z = spawn ({ tool, "-q", "-1", "-c" }, zattr);
+        close (fds[0]);
+        fds[0] = -1;
+        g = spawn (gen, gattr);
+        close (fds[1]);
+        fds[1] = -1;
+        gret = g.wait ();
+        zret = z.wait ();
+    }
+    catch (std::runtime_error&) {
+        for (int fd: { fds[0], fds[1], out, gattr.fd_in })
+            if (fd >= 0)
+                close (fd);
+        /* the compressor sees EOF once the pipe is closed */
+        if (g.pid > 0) {
+            g.kill (SIGKILL);
+            g.wait ();
+        }
+        if (z.pid > 0)
+            z.wait ();
+        unlink (tmp.c_str ());
+        throw;
+    }
+    close (out);
+    close (gattr.fd_in);
+
+    if (!exited_ok (gret) || !exited_ok (zret)) {
+        unlink (tmp.c_str ());
+        throw std::runtime_error (exited_ok (gret) ? tool + " failed" : "generator failed");
+    }
+    if (::rename (tmp.c_str (), cached.c_str ()) != 0)
+        throw std::runtime_error (cached.str () + ": " + strerror (errno));
+    return cached;
+}
+
+process input_cache :: stream (const ev::path& cached, int *read_fd) {
+    int fds[2];
+    if (pipe2 (fds, O_CLOEXEC) != 0)
+        throw std::runtime_error (std::string ("pipe: ") + strerror (errno));
+
+    spawn_attr attr;
+    attr.fd_out = fds[1];
+    process z;
+    try {
+        z = spawn ({ tool, "-q", "-d", "-c", cached.str () }, attr);
+    }
+    catch (std::runtime_error&) {
+        close (fds[0]);
+        close (fds[1]);
+        throw;
+    }
+    close (fds[1]);
+    *read_fd = fds[0];
+    return z;
+}
+
+void input_cache :: evict () {
+    DIR *d = opendir (dir.c_str ());
+    if (!d)
+        return;
+
+    struct entry_info {
+        std::string name;
+        ev::time mtime;
+        uint64_t size;
+    };
+    std::vector <entry_info> entries;
+    uint64_t total = 0;
+    time_t now = ::time (NULL);
+    while (struct dirent *ent = readdir (d)) {
+        /* <key>.<tool> only, not files still being written */
+        struct stat st;
+        const char *dot = strrchr (ent->d_name, '.');
+        if (!dot || fstatat (dirfd (d), ent->d_name, &st, 0) != 0 || !S_ISREG (st.st_mode))
+            continue;
+        if (strchr (ent->d_name, '.') != dot) {
+            /* left by a crash or Ctrl-C */
+            if (dot[1] && strspn (dot + 1, "0123456789") == strlen (dot + 1) &&
+                now - st.st_mtim.tv_sec > STALE_TMP_SEC)
+                unlinkat (dirfd (d), ent->d_name, 0);
+            continue;
+        }
+        entries.push_back ({ ent->d_name, ev::time (st.st_mtim.tv_sec, st.st_mtim.tv_nsec),
+                             (uint64_t)st.st_size });
+        total += st.st_size;
+    }
+    closedir (d);
+
+    std::sort (entries.begin (), entries.end (), [] (const entry_info& a, const entry_info& b) {
+        return a.mtime < b.mtime;
+    });
+    for (auto& e: entries) {
+        if (total <= budget)
+            break;
+        if (::unlink ((dir / ev::path (e.name)).c_str ()) == 0)
+            total -= e.size;
+    }
+}
+
+} // namespace ev
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "spawn.hh"
+#include "util.hh"
+
+namespace ev {
+
+/*
+ * Generated inputs, compressed by an external tool (zstd, lz4, gzip)
+ * and kept under a key of (generator executable, arguments). Entries
+ * are touched on every hit; evict drops the least recently used ones
+ * while the directory is over budget, and temp files a killed evx left.
+ */
+class input_cache {
+    ev::path dir;
+    std::string tool;
+    uint64_t budget;
+
+    ev::path entry (uint64_t key) const;
+
+public:
+    input_cache (ev::path dir, std::string tool, uint64_t budget);
+
+    /* First of zstd, lz4, gzip found in PATH */
+    static std::string default_tool ();
+
+    /* Compressed input for key, running gen to make it on a miss */
+    ev::path get (const std::vector <std::string>& gen, uint64_t key, bool *hit);
+
+    /* Decompress into a pipe; *read_fd becomes the child's stdin */
+    process stream (const ev::path& cached, int *read_fd);
+
+    /* Once the tests are done: run between them it races with other workers */
+    void evict ();
+};
+
+} // namespace ev
@@ -0,0 +1,237 @@
+#include <cctype>
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+
+#include "headers.hh"
+
+namespace ev {
+
+namespace {
+
+struct header_ids {
+    const char *header;
+    const char *ids;
+};
+
+/* identifier -> header, the subset of the library seen in solutions */
+const header_ids HEADER_TABLE[] = {
+    { "algorithm",      "sort stable_sort min max minmax min_element max_element "
+                        "minmax_element reverse unique lower_bound upper_bound "
+                        "binary_search equal_range next_permutation prev_permutation "
+                        "fill fill_n copy copy_n copy_if find find_if find_if_not count "
+                        "count_if nth_element partial_sort merge inplace_merge rotate "
+                        "shuffle random_shuffle all_of any_of none_of for_each transform "
+                        "remove remove_if replace replace_if clamp is_sorted "
+                        "lexicographical_compare set_union set_intersection "
+                        "set_difference set_symmetric_difference make_heap push_heap "
+                        "pop_heap sort_heap is_heap includes generate mismatch "
+                        "is_permutation search partition stable_partition __gcd __lg" },
+    { "array",          "array" },
+    { "bit",            "popcount countl_zero countl_one countr_zero countr_one "
+                        "bit_width bit_ceil bit_floor has_single_bit rotl rotr "
+                        "bit_cast" },
+    { "bitset",         "bitset" },
+    { "cassert",        "assert" },
+    { "cctype",         "isdigit isalpha isalnum isspace isupper islower ispunct "
+                        "isxdigit tolower toupper" },
+    { "cfloat",         "DBL_MAX DBL_MIN DBL_EPSILON FLT_MAX LDBL_MAX" },
+    { "chrono",         "chrono steady_clock high_resolution_clock system_clock "
+                        "duration_cast milliseconds microseconds nanoseconds" },
+    { "climits",        "INT_MAX INT_MIN UINT_MAX LONG_MAX LONG_MIN LLONG_MAX "
+                        "LLONG_MIN ULLONG_MAX CHAR_BIT SHRT_MAX" },
+    { "cmath",          "sqrt sqrtl cbrt pow powl exp exp2 log log2 log10 log1p sin cos "
+                        "tan asin acos atan atan2 sinh cosh tanh floor ceil round "
+                        "lround llround trunc fabs fabsl fmod hypot fma isnan isinf "
+                        "M_PI" },
+    { "complex",        "complex polar" },
+    { "cstdint",        "int8_t int16_t int32_t int64_t uint8_t uint16_t uint32_t "
+                        "uint64_t intmax_t uintmax_t INT64_MAX UINT64_MAX" },
+    { "cstdio",         "printf scanf fprintf fscanf sprintf snprintf sscanf puts "
+                        "fputs fgets getchar putchar getc putc getchar_unlocked "
+                        "putchar_unlocked fread fwrite fread_unlocked fwrite_unlocked "
+                        "fopen fclose freopen fflush setvbuf perror stdin stdout "
+                        "stderr FILE EOF" },
+    { "cstdlib",        "malloc calloc realloc free exit abort atoi atol atoll atof "
+                        "strtol strtoll strtoul strtoull strtod rand srand qsort bsearch "
+                        "getenv abs labs llabs" },
+    { "cstring",        "memset memcpy memmove memcmp memchr strlen strcmp strncmp "
+                        "strcpy strncpy strcat strchr strrchr strstr strtok" },
+    { "ctime",          "clock clock_t CLOCKS_PER_SEC time_t" },
+    { "deque",          "deque" },
+    { "fstream",        "ifstream ofstream fstream" },
+    { "functional",     "function greater greater_equal less less_equal equal_to "
+                        "plus minus multiplies bind" },
+    { "iomanip",        "setprecision setw setfill setbase quoted" },
+    { "iostream",       "cin cout cerr clog endl ws ios ios_base istream ostream "
+                        "fixed scientific boolalpha noskipws" },
+    { "iterator",       "back_inserter front_inserter inserter istream_iterator "
+                        "ostream_iterator advance distance prev next" },
+    { "limits",         "numeric_limits" },
+    { "list",           "list" },
+    { "map",            "map multimap" },
+    { "memory",         "unique_ptr shared_ptr weak_ptr make_unique make_shared" },
+    { "numeric",        "accumulate iota gcd lcm partial_sum adjacent_difference "
+                        "inner_product reduce inclusive_scan exclusive_scan" },
+    { "optional",       "optional nullopt" },
+    { "queue",          "queue priority_queue" },
+    { "random",         "mt19937 mt19937_64 minstd_rand random_device "
+                        "uniform_int_distribution uniform_real_distribution "
+                        "normal_distribution bernoulli_distribution" },
+    { "set",            "set multiset" },
+    { "sstream",        "stringstream istringstream ostringstream" },
+    { "stack",          "stack" },
+    { "string",         "string to_string stoi stol stoll stoul stoull stof stod "
+                        "getline" },
+    { "string_view",    "string_view" },
+    { "tuple",          "tuple make_tuple tie tuple_cat" },
+    { "unordered_map",  "unordered_map unordered_multimap" },
+    { "unordered_set",  "unordered_set unordered_multiset" },
+    { "utility",        "pair make_pair swap move forward exchange" },
+    { "valarray",       "valarray" },
+    { "variant",        "variant visit" },
+    { "vector",         "vector" },
+};
+
+const std::unordered_map <std::string, std::string>& header_index () {
+    static std::unordered_map <std::string, std::string> index;
+    if (!index.empty ())
+        return index;
+
+    for (auto& entry: HEADER_TABLE) {
+        std::string ids = entry.ids;
+        size_t pos = 0;
+        while (pos < ids.size ()) {
+            size_t end = ids.find (' ', pos);
+            if (end == std::string::npos)
+                end = ids.size ();
+            if (end > pos)
+                index.emplace (ids.substr (pos, end - pos), entry.header);
+            pos = end + 1;
+        }
+    }
+    return index;
+}
+
+bool is_id_char (char c) {
+    return std::isalnum ((unsigned char)c) || c == '_';
+}
+
+bool is_include_line (const std::string& source, size_t pos) {
+    while (pos < source.size () && (source[pos] == ' ' || source[pos] == '\t'))
+        ++pos;
+    if (pos >= source.size () || source[pos] != '#')
+        return false;
+    ++pos;
+    while (pos < source.size () && (source[pos] == ' ' || source[pos] == '\t'))
+        ++pos;
+    return source.compare (pos, 7, "include") == 0;
+}
+
+/* What #include lines name between open and close */
+std::vector <std::string> include_names (const std::string& source, char open_ch, char close_ch) {
+    std::vector <std::string> res;
+    size_t pos = 0;
+    while (pos < source.size ()) {
+        size_t end = source.find ('\n', pos);
+        if (end == std::string::npos)
+            end = source.size ();
+
+        if (is_include_line (source, pos)) {
+            size_t open = source.find (open_ch, pos),
+                   close = open == std::string::npos ? open : source.find (close_ch, open + 1);
+            if (open < end && close < end)
+                res.push_back (source.substr (open + 1, close - open - 1));
+        }
+        pos = end + 1;
+    }
+    return res;
+}
+
+/* R"delim( ... )delim" from the quote at i; the end of it */
+size_t skip_raw_string (const std::string& source, size_t i) {
+    size_t paren = source.find ('(', i + 1);
+    if (paren == std::string::npos)
+        return source.size ();
+    std::string close = ")" + source.substr (i + 1, paren - i - 1) + "\"";
+    size_t end = source.find (close, paren + 1);
+    return end == std::string::npos ? source.size () : end + close.size ();
+}
+
+} // namespace
+
+std::vector <std::string> needed_headers (const std::string& source) {
+    auto& index = header_index ();
+    std::set <std::string> res;
+
+    size_t i = 0, n = source.size ();
+    bool line_start = true;
+    while (i < n) {
+        char c = source[i];
+
+        if (line_start && is_include_line (source, i)) {
+            while (i < n && source[i] != '\n')
+                ++i;
+            continue;
+        }
+        line_start = false;
+
+        if (c == '\n') {
+            line_start = true;
+            ++i;
+        }
+        else if (c == '/' && i + 1 < n && source[i + 1] == '/') {
+            while (i < n && source[i] != '\n')
+                ++i;
+        }
+        else if (c == '/' && i + 1 < n && source[i + 1] == '*') {
+            size_t end = source.find ("*/", i + 2);
+            i = end == std::string::npos ? n : end + 2;
+        }
+        else if (c == '"' || c == '\'') {
+            for (++i; i < n && source[i] != c; ++i)
+                if (source[i] == '\\')
+                    ++i;
+            ++i;
+        }
+        else if (std::isdigit ((unsigned char)c)) {
+            /* 1'000'000: the separator is not a char literal */
+            while (i < n && (is_id_char (source[i]) || source[i] == '.' ||
+                             (source[i] == '\'' && i + 1 < n && is_id_char (source[i + 1]))))
+                ++i;
+        }
+        else if (is_id_char (c)) {
+            size_t start = i;
+            while (i < n && is_id_char (source[i]))
+                ++i;
+            std::string id = source.substr (start, i - start);
+            if (i < n && source[i] == '"' && (id == "R" || id == "LR" || id == "uR" ||
+                                              id == "UR" || id == "u8R")) {
+                i = skip_raw_string (source, i);
+                continue;
+            }
+
+            auto it = index.find (id);
+            if (it != index.end ())
+                res.insert (it->second);
+        }
+        else
+            ++i;
+    }
+
+    return std::vector <std::string> (res.begin (), res.end ());
+}
+
+std::vector <std::string> included_headers (const std::string& source) {
+    std::vector <std::string> res;
+    for (auto& header: include_names (source, '<', '>'))
+        if (header.compare (0, 5, "bits/") != 0)
+            res.push_back (header);
+    return res;
+}
+
+std::vector <std::string> local_includes (const std::string& source) {
+    return include_names (source, '"', '"');
+}
+
+} // namespace ev
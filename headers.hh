@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace ev {
+
+/*
+ * Standard headers a solution needs, guessed from the identifiers it
+ * uses. The result is sorted and may over-approximate (an identifier of
+ * the same name declared locally still pulls its header in).
+ */
+std::vector <std::string> needed_headers (const std::string& source);
+
+/* Headers already spelled out by #include <...> lines, except bits/ ones */
+std::vector <std::string> included_headers (const std::string& source);
+
+/* Names in #include "..." lines, as written */
+std::vector <std::string> local_includes (const std::string& source);
+
+} // namespace ev
@@ -0,0 +1,240 @@
+#include <cstdlib>
+#include <cxxabi.h>
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+
+#include "inspect.hh"
+
+namespace ev {
+
+namespace {
+
+std::vector <std::string> split_lines (const std::string& text) {
+    std::vector <std::string> res;
+    std::istringstream is (text);
+    std::string line;
+    while (std::getline (is, line))
+        res.push_back (line);
+    return res;
+}
+
+bool starts_with (const std::string& s, const std::string& prefix) {
+    return s.compare (0, prefix.size (), prefix) == 0;
+}
+
+bool contains (const std::string& s, const char *what) {
+    return s.find (what) != std::string::npos;
+}
+
+/* "Inlining int g(int)/155 into int main()/156." -> "int g(int) into int main()" */
+std::string shorten_inline (const std::string& msg) {
+    size_t space = msg.find (' '),
+           into = msg.find (" into ");
+    if (space == std::string::npos || into == std::string::npos || into < space)
+        return msg;
+
+    auto strip = [] (std::string fn) {
+        size_t cut = fn.find (" [with ");
+        if (cut == std::string::npos)
+            cut = fn.rfind ('/');
+        return cut == std::string::npos ? fn : fn.substr (0, cut);
+    };
+    std::string caller = msg.substr (into + 6);
+    size_t slash = caller.find ('/');
+    if (slash != std::string::npos)
+        caller.erase (slash);
+
+    return strip (msg.substr (space + 1, into - space - 1)) + " into " + strip (caller);
+}
+
+/* Drop template argument lists GCC appends to function names */
+std::string strip_with (std::string msg) {
+    size_t pos;
+    while ((pos = msg.find (" [with ")) != std::string::npos) {
+        size_t end = pos + 1;
+        for (int depth = 0; end < msg.size (); ++end) {
+            depth += msg[end] == '[';
+            depth -= msg[end] == ']';
+            if (depth == 0)
+                break;
+        }
+        msg.erase (pos, end + 1 - pos);
+    }
+    return msg;
+}
+
+/* Keep only labels that can be jump targets: .L<n> */
+bool is_jump_label (const std::string& line) {
+    if (line.size () < 4 || line.compare (0, 2, ".L") != 0 || line.back () != ':')
+        return false;
+    return line.find_first_not_of ("0123456789", 2) == line.size () - 1;
+}
+
+std::string demangle (const std::string& name) {
+    int status;
+    char *buf = abi::__cxa_demangle (name.c_str (), NULL, NULL, &status);
+    if (!buf)
+        return name;
+    std::string res (buf);
+    free (buf);
+    return res;
+}
+
+} // namespace
+
+std::vector <opt_remark> parse_remarks (const std::string& text, const std::string& source) {
+    std::vector <opt_remark> res;
+    std::string prefix = source + ":";
+
+    for (auto& line: split_lines (text)) {
+        if (!starts_with (line, prefix))
+            continue;
+
+        opt_remark rem;
+        char *end;
+        const char *p = line.c_str () + prefix.size ();
+        rem.line = strtol (p, &end, 10);
+        if (*end != ':')
+            continue;
+        rem.col = strtol (end + 1, &end, 10);
+        if (*end != ':')
+            continue;
+
+        std::string rest (end + 1);
+        size_t first = rest.find_first_not_of (' ');
+        rest = first == std::string::npos ? "" : rest.substr (first);
+
+        bool optimized, missed;
+        if (starts_with (rest, "optimized:") || starts_with (rest, "missed:")) {
+            /* GCC */
+            optimized = starts_with (rest, "optimized:");
+            missed = !optimized;
+            rest = rest.substr (rest.find (':') + 1);
+        }
+        else if (starts_with (rest, "remark:")) {
+            /* Clang: the pass is named in the trailing [-Rpass...] */
+            optimized = contains (rest, "[-Rpass=");
+            missed = contains (rest, "[-Rpass-missed=") || contains (rest, "[-Rpass-analysis=");
+            rest = rest.substr (7);
+            size_t flag = rest.rfind (" [-Rpass");
+            if (flag != std::string::npos)
+                rest.erase (flag);
+        }
+        else
+            continue;
+
+        first = rest.find_first_not_of (' ');
+        rest = first == std::string::npos ? "" : rest.substr (first);
+
+        bool vec = contains (rest, "vectoriz"),
+             inl = contains (rest, "nlin");
+        if (vec)
+            rem.kind = optimized ? "vec" : "novec";
+        else if (inl)
+            rem.kind = optimized ? "inline" : "noinline";
+        else if (optimized || missed)
+            rem.kind = optimized ? "opt" : "missed";
+        else
+            continue;
+
+        if (inl && optimized && starts_with (rest, "Inlin"))
+            rest = shorten_inline (rest);
+        rem.msg = strip_with (rest);
+        res.push_back (rem);
+    }
+
+    std::sort (res.begin (), res.end (), [] (const opt_remark& a, const opt_remark& b) {
+        if (a.line != b.line)
+            return a.line < b.line;
+        if (a.kind != b.kind)
+            return a.kind < b.kind;
+        return a.msg < b.msg;
+    });
+    res.erase (std::unique (res.begin (), res.end (), [] (const opt_remark& a, const opt_remark& b) {
+        return a.line == b.line && a.kind == b.kind && a.msg == b.msg;
+    }), res.end ());
+
+    return res;
+}
+
+void print_remarks (std::ostream& os, const std::vector <opt_remark>& remarks,
+                    const std::string& source_text) {
+    auto lines = split_lines (source_text);
+    int cur = 0;
+
+    for (auto& rem: remarks) {
+        if (rem.line != cur) {
+            cur = rem.line;
+            std::string text = cur > 0 && (size_t)cur <= lines.size () ? lines[cur - 1] : "";
+            size_t first = text.find_first_not_of (" \t");
+            text = first == std::string::npos ? "" : text.substr (first);
+            char buf[16];
+            snprintf (buf, sizeof (buf), "%5d | ", cur);
+            os << buf << text << "\n";
+        }
+        char buf[24];
+        snprintf (buf, sizeof (buf), "        %-9s ", rem.kind.c_str ());
+        os << buf << rem.msg << "\n";
+    }
+}
+
+bool annotate_asm (std::ostream& os, const std::string& asm_text, const std::string& function,
+                   const std::string& source, const std::string& source_text) {
+    auto lines = split_lines (source_text);
+    std::map <int, std::string> files;
+    bool in_func = false, found = false;
+    int last_line = -1;
+
+    for (auto& line: split_lines (asm_text)) {
+        std::istringstream ls (line);
+        std::string op;
+        ls >> op;
+
+        if (op == ".file") {
+            /* .file N "name" or, with DWARF 5, .file N "dir" "name" */
+            int n;
+            if (!(ls >> n))
+                continue;
+            std::string rest;
+            std::getline (ls, rest);
+            size_t q = rest.rfind ('"'), p = rest.rfind ('"', q - 1);
+            if (q != std::string::npos && p != std::string::npos)
+                files[n] = rest.substr (p + 1, q - p - 1);
+            continue;
+        }
+
+        if (!in_func) {
+            if (line.empty () || line[0] == '\t' || line[0] == '.' || line.back () != ':')
+                continue;
+            std::string name = demangle (line.substr (0, line.size () - 1));
+            if (name.find (function) == std::string::npos)
+                continue;
+            in_func = found = true;
+            os << name << ":\n";
+            continue;
+        }
+
+        if (op == ".cfi_endproc" || op == ".size")
+            break;
+
+        if (op == ".loc") {
+            int file, lineno;
+            if (ls >> file >> lineno && files[file] == source && lineno != last_line &&
+                lineno > 0 && (size_t)lineno <= lines.size ()) {
+                last_line = lineno;
+                os << "  ; " << lineno << ": " << lines[lineno - 1] << "\n";
+            }
+            continue;
+        }
+
+        if (!op.empty () && op[0] == '.' && !is_jump_label (line))
+            continue;
+        os << line << "\n";
+    }
+
+    return found;
+}
+
+} // namespace ev
@@ -0,0 +1,32 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ev {
+
+struct opt_remark {
+    int line,
+        col;
+    std::string kind;   /* vec, novec, inline, noinline, opt, missed */
+    std::string msg;
+};
+
+/*
+ * Parse GCC -fopt-info or Clang -Rpass output, keeping only remarks
+ * about source. Sorted by position, duplicates dropped.
+ */
+std::vector <opt_remark> parse_remarks (const std::string& text, const std::string& source);
+
+void print_remarks (std::ostream& os, const std::vector <opt_remark>& remarks,
+                    const std::string& source_text);
+
+/*
+ * Print instructions of the first function whose demangled name contains
+ * function, with source lines interleaved at .loc directives. Returns
+ * false if there is no such function.
+ */
+bool annotate_asm (std::ostream& os, const std::string& asm_text, const std::string& function,
+                   const std::string& source, const std::string& source_text);
+
+} // namespace ev
@@ -0,0 +1,137 @@
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "memo.hh"
+
+namespace ev {
+
+namespace {
+
+int64_t to_nsec (const ev::time& t) {
+    return (int64_t)(t.to_sec () * EV_NANOSEC_IN_SEC + 0.5);
+}
+
+ev::time from_nsec (int64_t ns) {
+    return ev::time (ns / EV_NANOSEC_IN_SEC, ns % EV_NANOSEC_IN_SEC);
+}
+
+int64_t to_usec (const struct timeval& tv) {
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+struct timeval from_usec (int64_t us) {
+    struct timeval tv;
+    tv.tv_sec = us / 1000000;
+    tv.tv_usec = us % 1000000;
+    return tv;
+}
+
+/* All of str as hex, so a torn or foreign field does not pass */
+bool parse_hex (const std::string& str, uint64_t *res) {
+    char *end;
+    errno = 0;
+    *res = strtoull (str.c_str (), &end, 16);
+    return !str.empty () && std::isxdigit ((unsigned char)str[0]) && *end == '\0' && errno == 0;
+}
+
+} // namespace
+
+result_memo :: result_memo (ev::path file_):
+    file    (file_),
+    entries (),
+    lock    (),
+    dirty   (false)
+{
+    std::ifstream is (file.str ());
+    std::string line;
+    while (std::getline (is, line)) {
+        std::istringstream ls (line);
+        std::string key, out_hash;
+        int64_t wall, utime, stime, check_wall;
+        memo_entry e;
+        uint64_t k;
+        if (!(ls >> key >> e.used >> e.verdict >> e.status >> wall >> utime >> stime
+                 >> e.maxrss >> out_hash >> check_wall) ||
+            !parse_hex (key, &k) || !parse_hex (out_hash, &e.out_hash))
+            continue;   /* a line from another version, or a torn write */
+        if (ls.peek () == ' ')
+            ls.get ();
+        std::getline (ls, e.comment);
+
+        e.wall = from_nsec (wall);
+        e.utime = from_usec (utime);
+        e.stime = from_usec (stime);
+        e.checked = check_wall >= 0;
+        e.check_wall = e.checked ? from_nsec (check_wall) : ev::time ();
+        entries[k] = e;
+    }
+}
+
+result_memo :: ~result_memo () {
+    if (!dirty)
+        return;
+    try {
+        write ();
+    }
+    catch (std::runtime_error& e) {
+        ev::log (LOG_ERR, "%s", e.what ());
+    }
+}
+
+bool result_memo :: find (uint64_t key, memo_entry *entry) {
+    std::lock_guard <std::mutex> guard (lock);
+    auto it = entries.find (key);
+    if (it == entries.end ())
+        return false;
+    it->second.used = ::time (NULL);
+    dirty = true;
+    *entry = it->second;
+    return true;
+}
+
+void result_memo :: put (uint64_t key, const memo_entry& entry) {
+    std::lock_guard <std::mutex> guard (lock);
+    memo_entry& e = entries[key] = entry;
+    e.used = ::time (NULL);
+    dirty = true;
+}
+
+void result_memo :: write (size_t max_entries) {
+    std::lock_guard <std::mutex> guard (lock);
+
+    std::vector <std::pair <time_t, uint64_t>> by_use;
+    for (auto& e: entries)
+        by_use.emplace_back (e.second.used, e.first);
+    std::sort (by_use.begin (), by_use.end ());
+    for (size_t i = 0; i + max_entries < by_use.size (); ++i)
+        entries.erase (by_use[i].second);
+
+    /* write and rename, so a concurrent reader sees either version */
+    ev::path tmp (file.str () + ".tmp");
+    {
+        std::ofstream os (tmp.str ());
+        if (!os)
+            throw std::runtime_error (tmp.str () + ": " + strerror (errno));
+        for (auto& kv: entries) {
+            const memo_entry& e = kv.second;
+            os << ev::n2hex (kv.first) << ' ' << e.used << ' ' << e.verdict << ' '
+               << e.status << ' ' << to_nsec (e.wall) << ' ' << to_usec (e.utime) << ' '
+               << to_usec (e.stime) << ' ' << e.maxrss << ' ' << ev::n2hex (e.out_hash) << ' '
+               << (e.checked ? to_nsec (e.check_wall) : -1) << ' ' << e.comment << '\n';
+        }
+    }
+    if (::rename (tmp.c_str (), file.c_str ()) != 0)
+        throw std::runtime_error (file.str () + ": " + strerror (errno));
+    dirty = false;
+}
+
+} // namespace ev
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "spawn.hh"
+#include "util.hh"
+
+namespace ev {
+
+/* Least recently used entries beyond this are dropped on write */
+const size_t MEMO_MAX_ENTRIES = 1 << 16;
+
+/*
+ * What a test run produced, kept under a key of everything it depends
+ * on: the solution and checker executables, the input and answer, the
+ * env profile and the time limit. One line per entry:
+ *     <key> <used> <verdict> <status> <wall ns> <utime us> <stime us>
+ *     <maxrss> <output hash> <check wall ns or -1> <comment>
+ */
+struct memo_entry {
+    int verdict;
+    int status;
+    ev::time wall;
+    struct timeval utime,
+                   stime;
+    long maxrss;
+    uint64_t out_hash;
+    bool checked;
+    ev::time check_wall;
+    std::string comment;
+    time_t used;            /* for eviction */
+};
+
+class result_memo {
+    ev::path file;
+    std::map <uint64_t, memo_entry> entries;
+    std::mutex lock;
+    bool dirty;
+
+public:
+    explicit result_memo (ev::path file);
+    result_memo (const result_memo&) = delete;
+    ~result_memo ();    /* writes back if anything changed */
+
+    bool find (uint64_t key, memo_entry *entry);
+    void put (uint64_t key, const memo_entry& entry);
+
+    void write (size_t max_entries = MEMO_MAX_ENTRIES);
+};
+
+} // namespace ev
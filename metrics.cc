@@ -0,0 +1,162 @@
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <stdexcept>
+
+#include "metrics.hh"
+#include "util.hh"
+
+namespace ev {
+
+namespace {
+
+int metrics_fd = -1;
+
+void append_json_string (std::string& out, const std::string& s) {
+    out += '"';
+    for (unsigned char c: s) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n";  break;
+            case '\t': out += "\\t";  break;
+            default:
+                if (c < 0x20) {
+                    char buf[8];
+                    snprintf (buf, sizeof (buf), "\\u%04x", c);
+                    out += buf;
+                }
+                else
+                    out += c;
+        }
+    }
+    out += '"';
+}
+
+} // namespace
+
+void set_metrics_sink (const std::string& where) {
+    if (metrics_fd > 2)
+        close (metrics_fd);
+    metrics_fd = -1;
+    if (where.empty ())
+        return;
+
+    char *end;
+    long fd = strtol (where.c_str (), &end, 10);
+    if (*end == '\0' && fd >= 0) {
+        int flags = fcntl (fd, F_GETFD);
+        if (flags < 0)
+            throw std::runtime_error ("metrics fd " + where + ": " + strerror (errno));
+        /* not for solutions and compilers to inherit; 1 and 2 they need */
+        if (fd > 2)
+            fcntl (fd, F_SETFD, flags | FD_CLOEXEC);
+        metrics_fd = fd;
+        return;
+    }
+
+    metrics_fd = open (where.c_str (), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (metrics_fd < 0)
+        throw std::runtime_error (where + ": " + strerror (errno));
+}
+
+bool metrics_enabled () {
+    return metrics_fd >= 0;
+}
+
+metric :: metric (const char *event):
+    line ()
+{
+    if (!metrics_enabled ())
+        return;
+    add ("v", METRICS_VERSION);
+    add ("event", event);
+    add ("ts", ev::time::now ().to_sec ());
+}
+
+metric :: ~metric () {
+    if (!metrics_enabled ())
+        return;
+    line += "}\n";
+
+    const char *p = line.data ();
+    size_t left = line.size ();
+    while (left > 0) {
+        ssize_t n = write (metrics_fd, p, left);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        p += n;
+        left -= n;
+    }
+}
+
+metric& metric :: key (const char *name) {
+    line += line.empty () ? "{" : ",";
+    append_json_string (line, name);
+    line += ':';
+    return *this;
+}
+
+metric& metric :: add (const char *name, const std::string& value) {
+    if (metrics_enabled ())
+        append_json_string (key (name).line, value);
+    return *this;
+}
+
+metric& metric :: add (const char *name, const char *value) {
+    return add (name, std::string (value));
+}
+
+metric& metric :: add (const char *name, double value) {
+    if (metrics_enabled ()) {
+        /* JSON has no nan or inf */
+        char buf[512];
+        snprintf (buf, sizeof (buf), "%.6f", value);
+        key (name).line += std::isfinite (value) ? buf : "null";
+    }
+    return *this;
+}
+
+metric& metric :: add (const char *name, int64_t value) {
+    if (metrics_enabled ())
+        key (name).line += std::to_string (value);
+    return *this;
+}
+
+metric& metric :: add (const char *name, int value) {
+    return add (name, (int64_t)value);
+}
+
+metric& metric :: add (const char *name, uint64_t value) {
+    if (metrics_enabled ())
+        key (name).line += std::to_string (value);
+    return *this;
+}
+
+metric& metric :: add (const char *name, bool value) {
+    if (metrics_enabled ())
+        key (name).line += value ? "true" : "false";
+    return *this;
+}
+
+metric& metric :: add (const char *name, const std::vector <std::string>& values) {
+    if (!metrics_enabled ())
+        return *this;
+    key (name).line += '[';
+    for (size_t i = 0; i < values.size (); ++i) {
+        if (i)
+            line += ',';
+        append_json_string (line, values[i]);
+    }
+    line += ']';
+    return *this;
+}
+
+} // namespace ev
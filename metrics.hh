@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ev {
+
+/*
+ * Machine-readable metrics: one JSON object per line, written with a
+ * single write () so lines from parallel writers do not interleave.
+ * Every line carries
+ *     "v":     schema version, bumped on incompatible changes
+ *     "event": what happened (build, run, ...)
+ *     "ts":    wall clock seconds
+ * and event specific keys; keys are only ever added within a version.
+ */
+const int METRICS_VERSION = 1;
+
+/* "<fd>" or a file name to append to; empty disables metrics */
+void set_metrics_sink (const std::string& where);
+bool metrics_enabled ();
+
+class metric {
+    std::string line;
+
+    metric& key (const char *name);
+
+public:
+    explicit metric (const char *event);
+    metric (const metric&) = delete;
+    ~metric ();     /* emits the line */
+
+    metric& add (const char *name, const std::string& value);
+    metric& add (const char *name, const char *value);
+    metric& add (const char *name, double value);
+    metric& add (const char *name, int64_t value);
+    metric& add (const char *name, int value);
+    metric& add (const char *name, uint64_t value);
+    metric& add (const char *name, bool value);
+    metric& add (const char *name, const std::vector <std::string>& values);
+};
+
+} // namespace ev
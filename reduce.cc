@@ -0,0 +1,214 @@
+#include <cstdint>
+#include <cstdlib>
+
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "reduce.hh"
+
+namespace ev {
+
+namespace {
+
+enum count_kind {
+    COUNT_NONE,
+    COUNT_LINES,    /* lines below the header */
+    COUNT_TOKENS    /* tokens of the first line below */
+};
+
+/* A line, or with token >= 0 one token of it */
+struct unit {
+    size_t line;
+    int token;
+};
+
+struct document {
+    std::vector <std::string> header;       /* empty: no header */
+    std::vector <count_kind> counts;
+    std::vector <std::vector <std::string>> lines;
+};
+
+std::vector <std::string> split_tokens (const std::string& line) {
+    std::istringstream is (line);
+    std::vector <std::string> res;
+    std::string tok;
+    while (is >> tok)
+        res.push_back (tok);
+    return res;
+}
+
+bool is_integer (const std::string& s) {
+    size_t i = s[0] == '-' ? 1 : 0;
+    return i < s.size () && s.find_first_not_of ("0123456789", i) == std::string::npos;
+}
+
+document parse (const std::string& input) {
+    document doc;
+    std::istringstream is (input);
+    std::string line;
+    while (std::getline (is, line))
+        doc.lines.push_back (split_tokens (line));
+    if (doc.lines.empty ())
+        return doc;
+
+    auto& first = doc.lines[0];
+    if (first.empty () || !std::all_of (first.begin (), first.end (), is_integer))
+        return doc;
+
+    size_t body = doc.lines.size () - 1,
+           next = body ? doc.lines[1].size () : 0;
+    std::vector <count_kind> counts;
+    bool any = false;
+    for (auto& field: first) {
+        long long v = atoll (field.c_str ());
+        count_kind k = v == (long long)body ? COUNT_LINES :
+                       next > 1 && v == (long long)next ? COUNT_TOKENS : COUNT_NONE;
+        any |= k != COUNT_NONE;
+        counts.push_back (k);
+    }
+    if (!any)
+        return doc;
+
+    doc.header = first;
+    doc.counts = counts;
+    doc.lines.erase (doc.lines.begin ());
+    return doc;
+}
+
+std::string render (const document& doc, const std::vector <unit>& kept) {
+    std::string body;
+    size_t nlines = 0, first_tokens = 0;
+    for (size_t i = 0; i < kept.size (); ) {
+        size_t line = kept[i].line, ntokens = 0;
+        for (; i < kept.size () && kept[i].line == line; ++i) {
+            if (kept[i].token < 0) {
+                for (auto& tok: doc.lines[line])
+                    body += (ntokens++ ? " " : "") + tok;
+            }
+            else
+                body += (ntokens++ ? " " : "") + doc.lines[line][kept[i].token];
+        }
+        body += '\n';
+        if (nlines++ == 0)
+            first_tokens = ntokens;
+    }
+
+    if (doc.header.empty ())
+        return body;
+
+    std::string res;
+    for (size_t i = 0; i < doc.header.size (); ++i) {
+        res += i ? " " : "";
+        switch (doc.counts[i]) {
+            case COUNT_LINES:  res += std::to_string (nlines);       break;
+            case COUNT_TOKENS: res += std::to_string (first_tokens); break;
+            case COUNT_NONE:   res += doc.header[i];                 break;
+        }
+    }
+    return res + "\n" + body;
+}
+
+/*
+ * Index of the first candidate for which test holds, or -1. Candidates
+ * after one that held are not started; the ones before still finish, so
+ * the answer is the same on any number of threads.
+ */
+long first_holding (size_t count, const std::function <bool (size_t)>& test, int jobs) {
+    std::atomic <size_t> next (0), best (SIZE_MAX);
+    auto worker = [&] () {
+        for (size_t i; (i = next++) < count && i < best; ) {
+            if (!test (i))
+                continue;
+            size_t cur = best;
+            while (i < cur && !best.compare_exchange_weak (cur, i))
+                ;
+        }
+    };
+
+    size_t n = std::max (1, std::min (jobs, (int)count));
+    std::vector <std::thread> workers;
+    for (size_t i = 1; i < n; ++i)
+        workers.emplace_back (worker);
+    worker ();
+    for (auto& t: workers)
+        t.join ();
+    return best == SIZE_MAX ? -1 : (long)best;
+}
+
+/* ddmin: chunks and their complements, granularity doubling on failure */
+std::vector <unit> ddmin (const document& doc, std::vector <unit> units, const reduce_pred& pred,
+                          int jobs, std::atomic <size_t>& tests) {
+    size_t n = 2;
+    while (!units.empty ()) {
+        n = std::min (n, units.size ());
+        size_t subsets = n > 2 ? n : 0;     /* for n = 2 they are the complements */
+
+        auto candidate = [&units, n, subsets] (size_t i) {
+            bool complement = i >= subsets;
+            size_t chunk = complement ? i - subsets : i,
+                   lo = chunk * units.size () / n,
+                   hi = (chunk + 1) * units.size () / n;
+            std::vector <unit> res;
+            for (size_t j = 0; j < units.size (); ++j)
+                if ((j >= lo && j < hi) != complement)
+                    res.push_back (units[j]);
+            return res;
+        };
+
+        long win = first_holding (subsets + n, [&] (size_t i) {
+            ++tests;
+            return pred (render (doc, candidate (i)));
+        }, jobs);
+
+        if (win >= 0) {
+            units = candidate (win);
+            n = (size_t)win < subsets ? 2 : std::max (n - 1, (size_t)2);
+            continue;
+        }
+        if (n >= units.size ())
+            break;
+        n = std::min (units.size (), n * 2);
+    }
+    return units;
+}
+
+} // namespace
+
+std::string reduce_input (const std::string& input, const reduce_pred& pred, int jobs,
+                          reduce_stats *stats) {
+    document doc = parse (input);
+    std::atomic <size_t> tests (0);
+
+    std::vector <unit> units;
+    for (size_t i = 0; i < doc.lines.size (); ++i)
+        units.push_back ({ i, -1 });
+    ++tests;
+    if (!pred (render (doc, units)))
+        throw std::runtime_error ("input does not fail with whitespace normalized");
+
+    units = ddmin (doc, units, pred, jobs, tests);
+
+    std::vector <unit> tokens;
+    for (auto& u: units) {
+        if (doc.lines[u.line].empty ())
+            tokens.push_back (u);
+        for (size_t t = 0; t < doc.lines[u.line].size (); ++t)
+            tokens.push_back ({ u.line, (int)t });
+    }
+    tokens = ddmin (doc, tokens, pred, jobs, tests);
+
+    stats->tests = tests;
+    stats->lines_before = doc.lines.size ();
+    stats->lines_after = 0;
+    for (size_t i = 0; i < tokens.size (); ++i)
+        stats->lines_after += i == 0 || tokens[i].line != tokens[i - 1].line;
+    stats->tokens_after = tokens.size ();
+    stats->header = !doc.header.empty ();
+    return render (doc, tokens);
+}
+
+} // namespace ev
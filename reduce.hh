@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <string>
+
+namespace ev {
+
+/* Does the candidate input still show the bug; called from many threads */
+typedef std::function <bool (const std::string&)> reduce_pred;
+
+struct reduce_stats {
+    size_t tests;           /* candidates tried */
+    size_t lines_before,
+           lines_after,
+           tokens_after;
+    bool header;            /* counts in the first line were kept in sync */
+};
+
+/*
+ * ddmin over the lines of input, then over the tokens left: drop chunks
+ * while pred holds, halving the chunk size when nothing can go. All
+ * candidates of a round are tried on jobs threads, and the first one in
+ * order that holds wins, so the result does not depend on timing.
+ *
+ * A first line of integers counting the lines below it (n for n lines,
+ * n m for m edges) or the tokens of the next line (n before an array) is
+ * a header: it is never dropped and its counts follow the reduced input.
+ */
+std::string reduce_input (const std::string& input, const reduce_pred& pred, int jobs,
+                          reduce_stats *stats);
+
+} // namespace ev
@@ -9,6 +9,9 @@
 #include <sys/types.h>
 #include <time.h>
 #include <fcntl.h>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 
 #include "repo.hh"
@@ -121,6 +124,35 @@ bool check_dir (ev::path dir) {
     return ret;
 }
 
+/* Paths and test names go into keys: keep '=', '%' and blanks out of them */
+std::string escape_key (const std::string& s) {
+    std::string res;
+    for (char c: s) {
+        if (c == '=' || c == '%' || std::isspace ((unsigned char)c)) {
+            char buf[4];
+            snprintf (buf, sizeof (buf), "%%%02X", (unsigned char)c);
+            res += buf;
+        }
+        else
+            res += c;
+    }
+    return res;
+}
+
+std::string unescape_key (const std::string& s) {
+    std::string res;
+    for (size_t i = 0; i < s.size (); ++i) {
+        if (s[i] == '%' && i + 2 < s.size () && std::isxdigit ((unsigned char)s[i + 1]) &&
+            std::isxdigit ((unsigned char)s[i + 2])) {
+            res += (char)strtol (s.substr (i + 1, 2).c_str (), NULL, 16);
+            i += 2;
+        }
+        else
+            res += s[i];
+    }
+    return res;
+}
+
 } // namespace
 
 ev::time file_record :: mod_time_from_disk () {
@@ -136,10 +168,56 @@ ev::time file_record :: mod_time_from_disk () {
     return disk_time;
 }
 
+/*
+ * Headers are grouped by directory: each directory is resolved once and
+ * its entries are statx'ed relative to it, without forcing attribute
+ * sync on network filesystems. Stops at the first changed header.
+ */
+bool file_record :: deps_changed () const {
+    std::map <std::string, std::vector <std::pair <std::string, ev::time>>> by_dir;
+    for (auto& dep: deps) {
+        std::string dir = dep.first.dirname ().str ();
+        by_dir[dir].emplace_back (dep.first.str ().substr (dir.size () + (dir == "/" ? 0 : 1)),
+                                  dep.second);
+    }
+
+    for (auto& group: by_dir) {
+        int dir_fd = open (group.first.c_str (), O_PATH | O_DIRECTORY | O_CLOEXEC);
+        if (dir_fd < 0)
+            return true;
+
+        bool changed = false;
+        for (auto& entry: group.second) {
+            struct statx stx;
+            if (statx (dir_fd, entry.first.c_str (), AT_STATX_DONT_SYNC, STATX_MTIME, &stx) != 0 ||
+                ev::time (stx.stx_mtime.tv_sec, stx.stx_mtime.tv_nsec) != entry.second) {
+                changed = true;
+                break;
+            }
+        }
+        close (dir_fd);
+        if (changed)
+            return true;
+    }
+    return false;
+}
+
+void file_record :: set_deps (const std::vector <ev::path>& headers) {
+    deps.clear ();
+    for (auto& header: headers) {
+        struct stat buf;
+        if (stat (header.c_str (), &buf) == 0)
+            deps[header] = ev::time (buf.st_mtim.tv_sec, buf.st_mtim.tv_nsec);
+    }
+}
+
 repo :: repo ():
     dirname (find_dir ()),
     records (),
+    envs (),
     conf (),
+    machine (),
+    judge (),
     rnd (::time (NULL))
 {
     if (!check_dir (dirname))
@@ -150,8 +228,21 @@ repo :: repo ():
 
     conf = data[""];
     data.erase (data.find (""));
+    if (data.find (REPO_MACHINE) != data.end ()) {
+        machine = data[REPO_MACHINE];
+        data.erase (REPO_MACHINE);
+    }
+    if (data.find (REPO_JUDGE) != data.end ()) {
+        judge = data[REPO_JUDGE];
+        data.erase (REPO_JUDGE);
+    }
 
     for (auto& pair: data) {
+        if (pair.first.compare (0, REPO_ENV_PREFIX.size (), REPO_ENV_PREFIX) == 0) {
+            envs[pair.first.substr (REPO_ENV_PREFIX.size ())] = pair.second;
+            continue;
+        }
+
         file_record rec;
         rec.filename = ev::path (pair.first);
         if (pair.second["exec_filename"].empty ())
@@ -159,6 +250,25 @@ repo :: repo ():
         rec.exec_filename = ev::path (pair.second["exec_filename"]);
 
         rec.mod_time = ev::time (pair.second["mod_time"]);
+        rec.cc_time_full = ev::time (pair.second["cc_time_full"]);
+        rec.cc_time_narrow = ev::time (pair.second["cc_time_narrow"]);
+        rec.env = pair.second["env"];
+        rec.checker = pair.second["checker"];
+        rec.reference = pair.second["reference"];
+        rec.tests = pair.second["tests"];
+        for (auto& kv: pair.second) {
+            if (kv.first.compare (0, REPO_DEP_PREFIX.size (), REPO_DEP_PREFIX) == 0)
+                rec.deps[ev::path (unescape_key (kv.first.substr (REPO_DEP_PREFIX.size ())))] =
+                    ev::time (kv.second);
+            if (kv.first.compare (0, REPO_RUN_PREFIX.size (), REPO_RUN_PREFIX) == 0) {
+                /* <ok|fail> <cpu seconds> */
+                test_history h;
+                h.failed = kv.second.compare (0, 4, "fail") == 0;
+                size_t sp = kv.second.find (' ');
+                h.cpu = sp == std::string::npos ? 0 : atof (kv.second.c_str () + sp + 1);
+                rec.runs[unescape_key (kv.first.substr (REPO_RUN_PREFIX.size ()))] = h;
+            }
+        }
         records[rec.filename] = rec;
     }
 }
@@ -171,10 +281,35 @@ void repo :: write () const {
     std::fstream os ((dirname / REPO_FILENAME).str (), std::ios_base::out);
     ini::ini_t data;
     data[""] = conf;
+    for (auto& env: envs)
+        data[REPO_ENV_PREFIX + env.first] = env.second;
+    if (!machine.empty ())
+        data[REPO_MACHINE] = machine;
+    if (!judge.empty ())
+        data[REPO_JUDGE] = judge;
 
     for (auto &pair: records) {
         data[pair.first.str ()]["exec_filename"] = pair.second.exec_filename.str ();
         data[pair.first.str ()]["mod_time"] = pair.second.mod_time.to_string ();
+        if (pair.second.cc_time_full != ev::time ())
+            data[pair.first.str ()]["cc_time_full"] = pair.second.cc_time_full.to_string ();
+        if (pair.second.cc_time_narrow != ev::time ())
+            data[pair.first.str ()]["cc_time_narrow"] = pair.second.cc_time_narrow.to_string ();
+        if (!pair.second.env.empty ())
+            data[pair.first.str ()]["env"] = pair.second.env;
+        if (!pair.second.checker.empty ())
+            data[pair.first.str ()]["checker"] = pair.second.checker;
+        if (!pair.second.reference.empty ())
+            data[pair.first.str ()]["reference"] = pair.second.reference;
+        if (!pair.second.tests.empty ())
+            data[pair.first.str ()]["tests"] = pair.second.tests;
+        for (auto& dep: pair.second.deps)
+            data[pair.first.str ()][REPO_DEP_PREFIX + escape_key (dep.first.str ())] = dep.second.to_string ();
+        for (auto& run: pair.second.runs) {
+            char buf[32];
+            snprintf (buf, sizeof (buf), "%s %.6f", run.second.failed ? "fail" : "ok", run.second.cpu);
+            data[pair.first.str ()][REPO_RUN_PREFIX + escape_key (run.first)] = buf;
+        }
     }
 
     ini::write_to (os, data);
@@ -201,6 +336,25 @@ repo::conf_t& repo :: get_conf () {
     return conf;
 }
 
+repo::conf_t& repo :: get_machine () {
+    return machine;
+}
+
+repo::conf_t& repo :: get_judge () {
+    return judge;
+}
+
+ev::path repo :: get_dir () const {
+    return dirname;
+}
+
+const repo::conf_t& repo :: get_env (const std::string& name) const {
+    auto it = envs.find (name);
+    if (it == envs.end ())
+        throw std::runtime_error ("no env profile " + name);
+    return it->second;
+}
+
 bool repo :: exists (ev::path filename) const {
     return records.find (filename) != records.cend ();
 }
@@ -12,13 +12,35 @@ namespace ev {
 static const ev::path REPO_DIRNAME =  ev::path (".evd");
 static const ev::path REPO_FILENAME = ev::path ("evil");
 static const ev::path REPO_CONF =     ev::path ("conf");
+static const ev::path REPO_TEMPLATES = ev::path ("templates");
+static const std::string REPO_DEP_PREFIX = "dep:";
+static const std::string REPO_ENV_PREFIX = "env ";
+static const std::string REPO_RUN_PREFIX = "run:";
+static const std::string REPO_MACHINE = "machine";  /* calibration of this machine */
+static const std::string REPO_JUDGE = "judge";      /* same kernels, as timed on the judge */
+
+/* Outcome of a test in the last batch run, for scheduling the next */
+struct test_history {
+    bool failed;
+    double cpu;
+};
 
 struct file_record {
     ev::path filename;
     ev::path exec_filename;
     ev::time mod_time;
+    std::map <ev::path, ev::time> deps; /* local headers -> mtime at last build */
+    ev::time cc_time_full,              /* last compile with bits/stdc++.h */
+             cc_time_narrow;            /* last compile with narrowed includes */
+    std::string env;                    /* runtime env profile */
+    std::string checker;                /* checker source, relative to filename */
+    std::string reference;              /* known good solution, relative to filename */
+    std::string tests;                  /* tests dir, relative to filename */
+    std::map <std::string, test_history> runs;  /* test name -> last outcome */
 
     ev::time mod_time_from_disk ();
+    bool deps_changed () const;
+    void set_deps (const std::vector <ev::path>& headers);
 private:
     ev::time disk_time;
 };
@@ -30,7 +52,10 @@ public:
 private:
     ev::path dirname;
     std::map <ev::path, file_record> records;
-    conf_t conf;
+    std::map <std::string, conf_t> envs;
+    conf_t conf,
+           machine,
+           judge;
 
     std::mt19937 rnd;
 
@@ -45,6 +70,10 @@ public:
     void write () const;
 
     conf_t& get_conf ();
+    conf_t& get_machine ();
+    conf_t& get_judge ();
+    ev::path get_dir () const;
+    const conf_t& get_env (const std::string& name) const;
     bool exists (ev::path filename) const;
     file_record& operator [] (ev::path filename);
     void emplace (ev::path filename);
@@ -0,0 +1,244 @@
+#include <cerrno>
+#include <cstdio>
+#include <csignal>
+#include <cstring>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <poll.h>
+
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <stdexcept>
+
+#include "spawn.hh"
+
+extern char **environ;
+
+namespace ev {
+
+namespace {
+
+const size_t CHILD_STACK_SIZE = 64 * 1024;
+
+/* Everything the child needs is prepared by the parent: the child runs on
+ * the parent's memory and must not allocate */
+struct child_ctx {
+    char * const *argv;
+    char * const *envp;
+    const spawn_attr *attr;
+    cpu_set_t cpus;
+    sigset_t sigmask;
+    volatile int err;
+};
+
+int child_main (void *arg) {
+    child_ctx *ctx = static_cast <child_ctx *> (arg);
+    const spawn_attr& attr = *ctx->attr;
+
+    int fds[3] = { attr.fd_in, attr.fd_out, attr.fd_err };
+    for (int i = 0; i < 3; ++i) {
+        if (fds[i] < 0 || fds[i] == i)
+            continue;
+        if (dup2 (fds[i], i) < 0)
+            goto fail;
+    }
+
+    for (auto& lim: attr.rlimits)
+        if (setrlimit (lim.first, &lim.second) != 0)
+            goto fail;
+
+    if (!attr.cpus.empty () && sched_setaffinity (0, sizeof (ctx->cpus), &ctx->cpus) != 0)
+        goto fail;
+
+    if (attr.thp_disable && prctl (PR_SET_THP_DISABLE, 1, 0, 0, 0) != 0)
+        goto fail;
+
+    if (attr.new_pgrp && setpgid (0, 0) != 0)
+        goto fail;
+
+    /* The parent's handlers must not run here, on its memory: as posix_spawn */
+    for (int sig = 1; sig < _NSIG; ++sig) {
+        struct sigaction sa;
+        if (sigaction (sig, NULL, &sa) == 0 && sa.sa_handler != SIG_IGN && sa.sa_handler != SIG_DFL) {
+            sa.sa_handler = SIG_DFL;
+            sa.sa_flags = 0;
+            sigaction (sig, &sa, NULL);
+        }
+    }
+    sigprocmask (SIG_SETMASK, &ctx->sigmask, NULL);
+
+    if (attr.exec_fd >= 0)
+        syscall (SYS_execveat, attr.exec_fd, "", ctx->argv, ctx->envp, AT_EMPTY_PATH);
+    else
+        execvpe (ctx->argv[0], ctx->argv, ctx->envp);
+
+fail:
+    ctx->err = errno;
+    _exit (127);
+}
+
+io_counters read_proc_io (pid_t pid) {
+    io_counters io;
+    memset (&io, 0, sizeof (io));
+
+    char path[64], buf[512];
+    snprintf (path, sizeof (path), "/proc/%d/io", (int)pid);
+    int fd = open (path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return io;
+    ssize_t n = read (fd, buf, sizeof (buf) - 1);
+    close (fd);
+    if (n <= 0)
+        return io;
+    buf[n] = '\0';
+
+    unsigned long long rchar, wchar, syscr, syscw;
+    if (sscanf (buf, "rchar: %llu wchar: %llu syscr: %llu syscw: %llu",
+                &rchar, &wchar, &syscr, &syscw) == 4) {
+        io.valid = true;
+        io.rchar = rchar;
+        io.wchar = wchar;
+        io.syscr = syscr;
+        io.syscw = syscw;
+    }
+    return io;
+}
+
+} // namespace
+
+process :: process ():
+    pid   (-1),
+    start ()
+{}
+
+process :: process (pid_t pid_, ev::time start_):
+    pid   (pid_),
+    start (start_)
+{}
+
+exit_info process :: wait (bool account_io) {
+    exit_info res;
+    memset (&res.usage, 0, sizeof (res.usage));
+    memset (&res.io, 0, sizeof (res.io));
+    res.status = 0;
+
+    if (account_io) {
+        /* Leave the child a zombie so its /proc entry is still there */
+        siginfo_t info;
+        while (waitid (P_PID, pid, &info, WEXITED | WNOWAIT) < 0)
+            if (errno != EINTR)
+                throw std::runtime_error (std::string ("waitid: ") + strerror (errno));
+        res.io = read_proc_io (pid);
+    }
+
+    while (wait4 (pid, &res.status, 0, &res.usage) < 0)
+        if (errno != EINTR)
+            throw std::runtime_error (std::string ("wait4: ") + strerror (errno));
+
+    res.wall = ev::time::monotonic () - start;
+    pid = -1;
+    return res;
+}
+
+bool process :: poll_exit (double timeout, int wake_fd) {
+    int pidfd = syscall (SYS_pidfd_open, pid, 0);
+    if (pidfd < 0)
+        throw std::runtime_error (std::string ("pidfd_open: ") + strerror (errno));
+
+    struct pollfd fds[2] = {
+        { pidfd, POLLIN, 0 },
+        { wake_fd, POLLIN, 0 },
+    };
+    double deadline = ev::time::monotonic ().to_sec () + timeout;
+
+    int n;
+    for (;;) {
+        int ms = -1;
+        if (timeout >= 0) {
+            double left = deadline - ev::time::monotonic ().to_sec ();
+            ms = left > 0 ? (int)(left * 1000) + 1 : 0;
+        }
+        n = poll (fds, wake_fd >= 0 ? 2 : 1, ms);
+        if (n >= 0 || errno != EINTR)
+            break;
+    }
+    int err = errno;
+    close (pidfd);
+    if (n < 0)
+        throw std::runtime_error (std::string ("poll: ") + strerror (err));
+    return fds[0].revents != 0;
+}
+
+void process :: kill (int sig) {
+    if (pid > 0)
+        ::kill (pid, sig);
+}
+
+void process :: kill_group (int sig) {
+    if (pid > 0)
+        ::kill (-pid, sig);
+}
+
+process spawn (const std::vector <std::string>& args, const spawn_attr& attr) {
+    if (args.empty ())
+        throw std::runtime_error ("spawn: empty argv");
+
+    std::vector <char *> argv;
+    argv.reserve (args.size () + 1);
+    for (auto& arg: args)
+        argv.push_back (const_cast <char *> (arg.c_str ()));
+    argv.push_back (NULL);
+
+    std::vector <char *> envp;
+    if (!attr.env.empty ()) {
+        envp.reserve (attr.env.size () + 1);
+        for (auto& kv: attr.env)
+            envp.push_back (const_cast <char *> (kv.c_str ()));
+        envp.push_back (NULL);
+    }
+
+    child_ctx ctx;
+    ctx.argv = argv.data ();
+    ctx.envp = envp.empty () ? environ : envp.data ();
+    ctx.attr = &attr;
+    ctx.err = 0;
+    CPU_ZERO (&ctx.cpus);
+    for (int cpu: attr.cpus)
+        CPU_SET (cpu, &ctx.cpus);
+
+    /* No signal handler may run on the shared stack before exec */
+    sigset_t all;
+    sigfillset (&all);
+    pthread_sigmask (SIG_BLOCK, &all, &ctx.sigmask);
+
+    static thread_local char stack[CHILD_STACK_SIZE] __attribute__ ((aligned (16)));
+    ev::time start = ev::time::monotonic ();
+    pid_t pid = clone (child_main, stack + CHILD_STACK_SIZE,
+                       CLONE_VM | CLONE_VFORK | SIGCHLD, &ctx);
+    int save_errno = errno;
+
+    pthread_sigmask (SIG_SETMASK, &ctx.sigmask, NULL);
+
+    if (pid < 0)
+        throw std::runtime_error (std::string ("clone: ") + strerror (save_errno));
+
+    process child (pid, start);
+    if (ctx.err) {
+        child.wait ();
+        throw std::runtime_error (args[0] + ": " + strerror (ctx.err));
+    }
+
+    return child;
+}
+
+exit_info spawn_wait (const std::vector <std::string>& args, const spawn_attr& attr,
+                      bool account_io) {
+    return spawn (args, attr).wait (account_io);
+}
+
+} // namespace ev
@@ -0,0 +1,85 @@
+#pragma once
+#include <sched.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "util.hh"
+
+namespace ev {
+
+/* What to set up in the child between clone and exec */
+struct spawn_attr {
+    int fd_in,          /* -1 to inherit */
+        fd_out,
+        fd_err;
+    int exec_fd;        /* exec this fd instead of searching PATH, -1 to disable */
+    bool thp_disable;   /* PR_SET_THP_DISABLE, inherited through exec */
+    bool new_pgrp;      /* own process group, so kill_group reaches its children */
+
+    std::vector <std::pair <int, struct rlimit>> rlimits;
+    std::vector <int> cpus;             /* affinity, empty to inherit */
+    std::vector <std::string> env;      /* KEY=VALUE, empty to inherit */
+
+    spawn_attr ():
+        fd_in   (-1),
+        fd_out  (-1),
+        fd_err  (-1),
+        exec_fd (-1),
+        thp_disable (false),
+        new_pgrp (false),
+        rlimits (),
+        cpus    (),
+        env     ()
+    {}
+};
+
+/* /proc/<pid>/io, read while the child is a zombie */
+struct io_counters {
+    bool valid;
+    uint64_t rchar,     /* bytes passed to read-like calls */
+             wchar,
+             syscr,     /* read-like syscalls */
+             syscw;
+};
+
+struct exit_info {
+    int status;         /* as returned by wait4 */
+    ev::time wall;      /* monotonic */
+    struct rusage usage;
+    io_counters io;
+};
+
+class process {
+public:
+    pid_t pid;
+    ev::time start;
+
+    process ();
+    process (pid_t, ev::time);
+
+    exit_info wait (bool account_io = false);
+
+    /*
+     * Block until the child exits (true), or until timeout seconds pass
+     * or wake_fd turns readable (false); timeout < 0 waits for ever.
+     * Does not reap.
+     */
+    bool poll_exit (double timeout, int wake_fd = -1);
+    void kill (int sig);
+    void kill_group (int sig);  /* spawned with new_pgrp */
+};
+
+/*
+ * clone (CLONE_VM | CLONE_VFORK) + exec: no page tables are copied and no
+ * memory is allocated after the call. Throws if exec failed.
+ */
+process spawn (const std::vector <std::string>& args, const spawn_attr& attr = spawn_attr ());
+exit_info spawn_wait (const std::vector <std::string>& args, const spawn_attr& attr = spawn_attr (),
+                      bool account_io = false);
+
+} // namespace ev
@@ -0,0 +1,522 @@
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "test.hh"
+
+namespace ev {
+
+namespace {
+
+/* Read-only mapping of a whole file, empty files included */
+class mapping {
+    const char *data_;
+    size_t size_;
+
+public:
+    explicit mapping (int fd):
+        data_ (NULL),
+        size_ (0)
+    {
+        struct stat st;
+        if (fstat (fd, &st) != 0)
+            throw std::runtime_error (std::string ("fstat: ") + strerror (errno));
+        size_ = st.st_size;
+        if (size_ == 0)
+            return;
+        void *m = mmap (NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED)
+            throw std::runtime_error (std::string ("mmap: ") + strerror (errno));
+        data_ = static_cast <const char *> (m);
+    }
+    mapping (const mapping&) = delete;
+    ~mapping () {
+        if (data_)
+            munmap (const_cast <char *> (data_), size_);
+    }
+
+    const char *data () const { return data_; }
+    size_t size () const { return size_; }
+};
+
+bool is_space (char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+/* Whitespace-separated tokens must match exactly */
+bool tokens_equal (const mapping& a, const mapping& b) {
+    const char *p = a.data (), *pe = p + a.size (),
+               *q = b.data (), *qe = q + b.size ();
+    for (;;) {
+        while (p < pe && is_space (*p))
+            ++p;
+        while (q < qe && is_space (*q))
+            ++q;
+        if (p == pe || q == qe)
+            return p == pe && q == qe;
+
+        while (p < pe && q < qe && !is_space (*p) && *p == *q)
+            ++p, ++q;
+        bool p_end = p == pe || is_space (*p),
+             q_end = q == qe || is_space (*q);
+        if (!p_end || !q_end)
+            return false;
+    }
+}
+
+int open_input (const ev::path& input) {
+    int fd = open (input.c_str (), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::runtime_error (input.str () + ": " + strerror (errno));
+    return fd;
+}
+
+uint64_t mix (uint64_t key, uint64_t h) {
+    return ev::fnv1a (&h, sizeof (h), key);
+}
+
+/* Everything the result depends on besides setup.memo_key */
+uint64_t test_key (const test_setup& setup, const test_case& test) {
+    uint64_t key = setup.memo_key;
+    key = mix (key, test.gen.empty () ? ev::fnv1a (ev::read_file (test.input)) : test.gen_key);
+    key = mix (key, test.answer.str ().empty () ? 0 : ev::fnv1a (ev::read_file (test.answer)));
+    return key;
+}
+
+test_result from_memo (const test_case& test, const memo_entry& e) {
+    test_result res;
+    res.test = test;
+    res.v = (verdict)e.verdict;
+    res.run = exit_info ();
+    res.run.status = e.status;
+    res.run.wall = e.wall;
+    res.run.usage.ru_utime = e.utime;
+    res.run.usage.ru_stime = e.stime;
+    res.run.usage.ru_maxrss = e.maxrss;
+    res.checked = e.checked;
+    res.check = exit_info ();
+    res.check.wall = e.check_wall;
+    res.comment = e.comment;
+    res.cache_hit = false;
+    res.out_hash = e.out_hash;
+    res.memoized = true;
+    res.cancelled = false;
+    return res;
+}
+
+memo_entry to_memo (const test_result& res) {
+    memo_entry e;
+    e.verdict = res.v;
+    e.status = res.run.status;
+    e.wall = res.run.wall;
+    e.utime = res.run.usage.ru_utime;
+    e.stime = res.run.usage.ru_stime;
+    e.maxrss = res.run.usage.ru_maxrss;
+    e.out_hash = res.out_hash;
+    e.checked = res.checked;
+    e.check_wall = res.check.wall;
+    e.comment = res.comment;
+    e.used = 0;
+    return e;
+}
+
+} // namespace
+
+memfile :: memfile (const char *name):
+    fd_ (memfd_create (name, MFD_CLOEXEC))
+{
+    if (fd_ < 0)
+        throw std::runtime_error (std::string ("memfd_create: ") + strerror (errno));
+}
+
+memfile :: ~memfile () {
+    close (fd_);
+}
+
+std::string memfile :: proc_path () const {
+    return "/proc/" + std::to_string (getpid ()) + "/fd/" + std::to_string (fd_);
+}
+
+std::string memfile :: first_line () const {
+    char buf[256];
+    ssize_t n = pread (fd_, buf, sizeof (buf) - 1, 0);
+    if (n <= 0)
+        return "";
+    buf[n] = '\0';
+    char *nl = strchr (buf, '\n');
+    if (nl)
+        *nl = '\0';
+    return buf;
+}
+
+void memfile :: append (const std::string& data) {
+    for (size_t off = 0; off < data.size (); ) {
+        ssize_t n = write (fd_, data.data () + off, data.size () - off);
+        if (n < 0 && errno != EINTR)
+            throw std::runtime_error (std::string ("write: ") + strerror (errno));
+        off += n > 0 ? n : 0;
+    }
+}
+
+const char *verdict_name (verdict v) {
+    switch (v) {
+        case V_OK:   return "OK";
+        case V_WA:   return "WA";
+        case V_RE:   return "RE";
+        case V_TLE:  return "TLE";
+        case V_FAIL: return "FAIL";
+    }
+    return "?";
+}
+
+double test_result :: cpu () const {
+    ev::time utime (run.usage.ru_utime.tv_sec, run.usage.ru_utime.tv_usec * 1000);
+    ev::time stime (run.usage.ru_stime.tv_sec, run.usage.ru_stime.tv_usec * 1000);
+    return utime.to_sec () + stime.to_sec ();
+}
+
+std::vector <test_case> find_tests (ev::path dir) {
+    DIR *d = opendir (dir.c_str ());
+    if (!d)
+        throw std::runtime_error (dir.str () + ": " + strerror (errno));
+
+    std::vector <test_case> res;
+    while (struct dirent *ent = readdir (d)) {
+        std::string name = ent->d_name;
+        if (name.size () <= 3 || name.compare (name.size () - 3, 3, ".in") != 0)
+            continue;
+
+        test_case tc;
+        tc.name = name.substr (0, name.size () - 3);
+        tc.input = dir / ev::path (name);
+        for (const char *ext: { ".out", ".ans" }) {
+            ev::path answer = dir / ev::path (tc.name + ext);
+            if (answer.exists ()) {
+                tc.answer = answer;
+                break;
+            }
+        }
+        res.push_back (tc);
+    }
+    closedir (d);
+
+    std::sort (res.begin (), res.end (), [] (const test_case& a, const test_case& b) {
+        return a.name < b.name;
+    });
+
+    ev::path gen_file = dir / ev::path ("gen");
+    if (!gen_file.exists ())
+        return res;
+
+    std::istringstream is (ev::read_file (gen_file));
+    std::string line;
+    while (std::getline (is, line)) {
+        std::istringstream ls (line);
+        std::string word;
+        std::vector <std::string> words;
+        while (ls >> word && word[0] != '#')
+            words.push_back (word);
+        if (words.empty ())
+            continue;
+        if (words.size () < 2)
+            throw std::runtime_error (gen_file.str () + ": expected <name> <generator> [args...]");
+
+        test_case tc;
+        tc.name = words[0];
+        ev::path gen (words[1]);
+        tc.generator = gen.is_absolute () ? gen : dir / gen;
+        tc.gen.assign (words.begin () + 2, words.end ());
+        res.push_back (tc);
+    }
+    return res;
+}
+
+namespace {
+
+enum kill_reason {
+    KILLED_NONE,
+    KILLED_WALL,
+    KILLED_CANCEL
+};
+
+/* Wait for proc, killing it after wall seconds or once cancel_fd turns readable */
+exit_info wait_limited (process& proc, double wall, int cancel_fd, bool account_io, kill_reason *why) {
+    *why = KILLED_NONE;
+    if (!proc.poll_exit (wall, cancel_fd)) {
+        proc.kill (SIGKILL);
+        struct pollfd cancel = { cancel_fd, POLLIN, 0 };
+        *why = cancel_fd >= 0 && poll (&cancel, 1, 0) > 0 ? KILLED_CANCEL : KILLED_WALL;
+    }
+    return proc.wait (account_io);
+}
+
+std::string wall_comment (const char *who, double wall) {
+    char buf[64];
+    snprintf (buf, sizeof (buf), "%skilled after %.1lfs of wall time", who, wall);
+    return buf;
+}
+
+test_result run_fresh (const test_setup& setup, const test_case& test) {
+    test_result res;
+    res.test = test;
+    res.v = V_OK;
+    res.checked = false;
+    res.check = exit_info ();
+    res.cache_hit = false;
+    res.out_hash = 0;
+    res.memoized = false;
+    res.cancelled = false;
+
+    memfile out ("evx-out");
+    spawn_attr attr = setup.attr;
+    attr.exec_fd = setup.solution_fd;
+    attr.fd_out = out.fd ();
+
+    /* Generated input is decompressed straight into the solution's stdin */
+    process unpack;
+    if (!test.gen.empty ()) {
+        if (!setup.inputs)
+            throw std::runtime_error ("no input cache for generated test");
+        ev::path cached = setup.inputs->get (test.gen, test.gen_key, &res.cache_hit);
+        unpack = setup.inputs->stream (cached, &attr.fd_in);
+    }
+    else
+        attr.fd_in = open_input (test.input);
+    if (setup.time_limit > 0) {
+        /* SIGXCPU a second after the limit, SIGKILL one more later */
+        struct rlimit lim;
+        lim.rlim_cur = (rlim_t)std::ceil (setup.time_limit / setup.time_scale) + 1;
+        lim.rlim_max = lim.rlim_cur + 1;
+        attr.rlimits.push_back (std::make_pair (RLIMIT_CPU, lim));
+    }
+
+    double wall_limit = setup.time_limit > 0 ?
+                        TEST_WALL_FACTOR * setup.time_limit / setup.time_scale + 1 : TEST_WALL_DEFAULT;
+    kill_reason killed = KILLED_NONE;
+    process proc;
+    try {
+        proc = spawn (setup.solution, attr);
+        res.run = wait_limited (proc, wall_limit, setup.cancel_fd, true, &killed);
+        res.cancelled = killed == KILLED_CANCEL;
+    }
+    catch (std::runtime_error& e) {
+        if (proc.pid > 0) {
+            proc.kill (SIGKILL);
+            proc.wait ();
+        }
+        close (attr.fd_in);
+        if (unpack.pid > 0)
+            unpack.wait ();
+        res.v = V_FAIL;
+        res.comment = e.what ();
+        return res;
+    }
+    close (attr.fd_in);
+    if (res.cancelled) {
+        if (unpack.pid > 0)
+            unpack.wait ();
+        res.v = V_FAIL;
+        return res;
+    }
+    if (unpack.pid > 0) {
+        /* SIGPIPE if the solution stopped reading early; else it got less */
+        int st = unpack.wait ().status;
+        if (!(WIFEXITED (st) && WEXITSTATUS (st) == 0) && !(WIFSIGNALED (st) && WTERMSIG (st) == SIGPIPE)) {
+            res.v = V_FAIL;
+            res.comment = "decompressing the cached input failed";
+            return res;
+        }
+    }
+    {
+        mapping got (out.fd ());
+        res.out_hash = ev::fnv1a (got.data (), got.size ());
+    }
+
+    /*
+     * The hard RLIMIT_CPU SIGKILL comes past the limit, so the CPU time
+     * covers it; any other SIGKILL (OOM, RLIMIT_AS) is a crash.
+     */
+    int status = res.run.status;
+    bool cpu_killed = WIFSIGNALED (status) && WTERMSIG (status) == SIGXCPU;
+    bool over = setup.time_limit > 0 && (res.cpu () * setup.time_scale > setup.time_limit || cpu_killed);
+    if (over || killed == KILLED_WALL) {
+        res.v = V_TLE;
+        if (killed == KILLED_WALL)
+            res.comment = wall_comment ("", wall_limit);
+        return res;
+    }
+    if (!WIFEXITED (status) || WEXITSTATUS (status) != 0) {
+        res.v = V_RE;
+        return res;
+    }
+    if (test.answer.str ().empty ())
+        return res;
+
+    if (setup.checker.empty ()) {
+        int ans_fd = open_input (test.answer);
+        bool same;
+        {
+            mapping got (out.fd ()), want (ans_fd);
+            same = tokens_equal (got, want);
+        }
+        close (ans_fd);
+        if (!same)
+            res.v = V_WA;
+        return res;
+    }
+
+    /* testlib: checker <input> <output> <answer>; 0 ok, 1 wa, 2 pe */
+    memfile msg ("evx-chk");
+    spawn_attr chk_attr;
+    chk_attr.fd_in = open ("/dev/null", O_RDONLY | O_CLOEXEC);
+    chk_attr.fd_out = msg.fd ();
+    chk_attr.fd_err = msg.fd ();
+
+    auto args = setup.checker;
+    args.push_back (test.input.str ());
+    args.push_back (out.proc_path ());
+    args.push_back (test.answer.str ());
+    process checker;
+    try {
+        checker = spawn (args, chk_attr);
+        res.check = wait_limited (checker, wall_limit, setup.cancel_fd, false, &killed);
+        res.checked = killed == KILLED_NONE;
+        res.cancelled = killed == KILLED_CANCEL;
+        if (killed == KILLED_WALL)
+            res.comment = wall_comment ("checker ", wall_limit);
+    }
+    catch (std::runtime_error& e) {
+        if (checker.pid > 0) {
+            checker.kill (SIGKILL);
+            checker.wait ();
+        }
+        res.comment = e.what ();
+    }
+    close (chk_attr.fd_in);
+
+    if (!res.checked) {
+        res.v = V_FAIL;
+        return res;
+    }
+    res.comment = msg.first_line ();
+    int chk = WIFEXITED (res.check.status) ? WEXITSTATUS (res.check.status) : -1;
+    res.v = chk == 0 ? V_OK : (chk == 1 || chk == 2) ? V_WA : V_FAIL;
+    return res;
+}
+
+} // namespace
+
+void order_tests (std::vector <test_case>& tests, double time_limit) {
+    auto group = [time_limit] (const test_case& tc) {
+        if (tc.failed_last)
+            return 0;
+        if (tc.last_cpu < 0)
+            return 2;
+        if (time_limit > 0 && tc.last_cpu >= time_limit * TEST_NEAR_LIMIT)
+            return 1;
+        return 3;
+    };
+    std::stable_sort (tests.begin (), tests.end (), [&group] (const test_case& a, const test_case& b) {
+        int ga = group (a), gb = group (b);
+        return ga != gb ? ga < gb : a.last_cpu > b.last_cpu;
+    });
+}
+
+test_result run_test (const test_setup& setup, const test_case& test) {
+    if (!setup.memo)
+        return run_fresh (setup, test);
+
+    uint64_t key = test_key (setup, test);
+    memo_entry e;
+    if (setup.reuse && setup.memo->find (key, &e))
+        return from_memo (test, e);
+
+    test_result res = run_fresh (setup, test);
+    if (res.v != V_FAIL)     /* runner trouble says nothing about the solution */
+        setup.memo->put (key, to_memo (res));
+    return res;
+}
+
+std::vector <test_result> run_tests (const test_setup& setup_, const std::vector <test_case>& tests,
+                                     const std::function <void (const test_result&)>& done) {
+    std::vector <test_result> res (tests.size ());
+    std::vector <char> ran (tests.size (), 0);
+    std::atomic <size_t> next (0);
+    std::atomic <bool> failed (false);
+    std::mutex done_lock;
+
+    /* The first failure makes it readable, and every run still going dies */
+    test_setup setup = setup_;
+    if (setup.fail_fast) {
+        setup.cancel_fd = eventfd (0, EFD_CLOEXEC);
+        if (setup.cancel_fd < 0)
+            throw std::runtime_error (std::string ("eventfd: ") + strerror (errno));
+    }
+
+    auto worker = [&] () {
+        for (size_t i; !(setup.fail_fast && failed) && (i = next++) < tests.size (); ) {
+            try {
+                res[i] = run_test (setup, tests[i]);
+            }
+            catch (std::runtime_error& e) {
+                res[i].test = tests[i];
+                res[i].v = V_FAIL;
+                res[i].checked = false;
+                res[i].cache_hit = false;
+                res[i].out_hash = 0;
+                res[i].memoized = false;
+                res[i].cancelled = false;
+                res[i].comment = e.what ();
+            }
+            if (res[i].cancelled)
+                continue;
+            ran[i] = 1;
+            if (res[i].v != V_OK && !failed.exchange (true) && setup.cancel_fd >= 0) {
+                uint64_t one = 1;
+                if (write (setup.cancel_fd, &one, sizeof (one)) != sizeof (one))
+                    ev::log (LOG_WARN, "eventfd: %s", strerror (errno));
+            }
+            std::lock_guard <std::mutex> lock (done_lock);
+            done (res[i]);
+        }
+    };
+
+    size_t jobs = std::max (1, std::min (setup.jobs, (int)tests.size ()));
+    std::vector <std::thread> workers;
+    for (size_t i = 1; i < jobs; ++i)
+        workers.emplace_back (worker);
+    worker ();
+    for (auto& t: workers)
+        t.join ();
+    if (setup.cancel_fd >= 0)
+        close (setup.cancel_fd);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < res.size (); ++i)
+        if (ran[i]) {
+            if (kept != i)
+                res[kept] = std::move (res[i]);
+            ++kept;
+        }
+    res.resize (kept);
+    return res;
+}
+
+} // namespace ev
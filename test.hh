@@ -0,0 +1,144 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "gencache.hh"
+#include "memo.hh"
+#include "spawn.hh"
+#include "util.hh"
+
+namespace ev {
+
+enum verdict {
+    V_OK,
+    V_WA,       /* wrong answer or presentation error */
+    V_RE,       /* nonzero exit or signal */
+    V_TLE,
+    V_FAIL      /* checker or runner failure */
+};
+
+const char *verdict_name (verdict v);
+
+/* Output of a child lives in a memfd: no temp files, and the checker can
+ * open it by /proc path */
+class memfile {
+    int fd_;
+
+public:
+    explicit memfile (const char *name);
+    memfile (const memfile&) = delete;
+    ~memfile ();
+
+    int fd () const { return fd_; }
+    std::string proc_path () const;
+    std::string first_line () const;
+    void append (const std::string& data);
+};
+
+struct test_case {
+    std::string name;
+    ev::path input,
+             answer;    /* empty: only check the solution does not crash */
+
+    /* Generated tests have no input file but a line in the gen file */
+    ev::path generator;                 /* source */
+    std::vector <std::string> gen;      /* generator executable and arguments */
+    uint64_t gen_key;                   /* of the executable contents and arguments */
+
+    /* From the last batch run, for order_tests */
+    bool failed_last;
+    double last_cpu;                    /* < 0: never ran */
+
+    test_case ():
+        name (), input (), answer (), generator (), gen (), gen_key (0),
+        failed_last (false), last_cpu (-1)
+    {}
+};
+
+struct test_setup {
+    std::vector <std::string> solution;
+    int solution_fd;                    /* exec'ed with execveat */
+    spawn_attr attr;                    /* env profile of the solution */
+    std::vector <std::string> checker;  /* testlib-style, empty to compare tokens */
+    double time_limit;                  /* usr + sys seconds on the judge, 0 for none */
+    double time_scale;                  /* judge seconds per second here */
+    int jobs;
+    input_cache *inputs;                /* for generated tests */
+    result_memo *memo;                  /* NULL to always run */
+    uint64_t memo_key;                  /* of solution, checker, env and limits */
+    bool reuse;                         /* false: run anyway, refresh the memo */
+    bool fail_fast;                     /* stop the batch at the first failure */
+    int cancel_fd;                      /* readable: kill the run, set by run_tests */
+
+    test_setup ():
+        solution (),
+        solution_fd (-1),
+        attr (),
+        checker (),
+        time_limit (0),
+        time_scale (1),
+        jobs (1),
+        inputs (NULL),
+        memo (NULL),
+        memo_key (0),
+        reuse (true),
+        fail_fast (false),
+        cancel_fd (-1)
+    {}
+};
+
+struct test_result {
+    test_case test;
+    verdict v;
+    exit_info run;
+    bool checked;           /* check is valid: an external checker ran */
+    exit_info check;
+    std::string comment;    /* first line of checker output */
+    bool cache_hit;         /* generated input came from the cache */
+    uint64_t out_hash;      /* of the solution's output */
+    bool memoized;          /* not run: taken from setup.memo */
+    bool cancelled;         /* killed through setup.cancel_fd, says nothing */
+
+    double cpu () const;    /* usr + sys of the solution */
+};
+
+/*
+ * <name>.in with <name>.out or <name>.ans next to it, sorted by name,
+ * then one test per line of the dir's gen file:
+ *     <name> <generator source> [args...]
+ */
+std::vector <test_case> find_tests (ev::path dir);
+
+/*
+ * Wall clock a run gets, as a multiple of the CPU limit here plus a
+ * second, or outright without a time limit: a solution blocked on a read
+ * or asleep burns no CPU time.
+ */
+const double TEST_WALL_FACTOR = 2;
+const double TEST_WALL_DEFAULT = 60;
+
+/* Tests that took this much of the time limit last time go early */
+const double TEST_NEAR_LIMIT = 0.5;
+
+/*
+ * Most likely verdict-deciding first: tests that failed last time, then
+ * the ones near the time limit, then tests without history, then the
+ * rest. Longest first within each group, so no worker is left with a
+ * slow test at the end while the others idle.
+ */
+void order_tests (std::vector <test_case>& tests, double time_limit);
+
+/* Memoized result for test if setup allows it, else runs it and memoizes */
+test_result run_test (const test_setup& setup, const test_case& test);
+
+/*
+ * Run tests on setup.jobs workers. done is called for each result as it
+ * comes in, one at a time. Results are returned in the order of tests;
+ * with setup.fail_fast, the runs still going at the first failure are
+ * killed, and they and the tests not started are left out.
+ */
+std::vector <test_result> run_tests (const test_setup& setup, const std::vector <test_case>& tests,
+                                     const std::function <void (const test_result&)>& done);
+
+} // namespace ev
@@ -4,7 +4,10 @@
 #include <cstring>
 #include <unistd.h>
 #include <libgen.h>
+#include <fcntl.h>
+#include <sys/sendfile.h>
 
+#include <fstream>
 #include <sstream>
 
 #include "util.hh"
@@ -16,6 +19,69 @@ void die_errno (const char *msg, int save_errno, int exit_status) {
     exit (exit_status);
 }
 
+std::string read_file (const path& filename) {
+    std::ifstream is (filename.str (), std::ios_base::binary);
+    if (!is)
+        throw std::runtime_error (filename.str () + ": cannot open");
+    std::ostringstream ss;
+    ss << is.rdbuf ();
+    return ss.str ();
+}
+
+uint64_t parse_size (const std::string& str) {
+    char *end;
+    unsigned long long n = strtoull (str.c_str (), &end, 10);
+    if (end == str.c_str ())
+        throw std::runtime_error ("bad size: " + str);
+    switch (*end) {
+        case 'G': case 'g': n <<= 10; /* fallthrough */
+        case 'M': case 'm': n <<= 10; /* fallthrough */
+        case 'K': case 'k': n <<= 10; break;
+        case '\0': break;
+        default:
+            throw std::runtime_error ("bad size: " + str);
+    }
+    return n;
+}
+
+void copy_file (const path& from, const path& to, mode_t mode) {
+    int in = ::open (from.c_str (), O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+        throw std::runtime_error (from.str () + ": " + strerror (errno));
+
+    /* write to a temp name so a running copy is not truncated under it */
+    path tmp (to.str () + ".tmp");
+    int out = ::open (tmp.c_str (), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+    if (out < 0) {
+        int save_errno = errno;
+        ::close (in);
+        throw std::runtime_error (tmp.str () + ": " + strerror (save_errno));
+    }
+
+    ssize_t n;
+    while ((n = sendfile (out, in, NULL, 1 << 30)) > 0)
+        ;
+    int save_errno = errno;
+    ::close (in);
+    ::close (out);
+    if (n < 0 || ::rename (tmp.c_str (), to.c_str ()) != 0)
+        throw std::runtime_error (to.str () + ": " + strerror (n < 0 ? save_errno : errno));
+}
+
+uint64_t fnv1a (const void *data, size_t len, uint64_t seed) {
+    const unsigned char *p = static_cast <const unsigned char *> (data);
+    uint64_t h = seed;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+uint64_t fnv1a (const std::string& data) {
+    return fnv1a (data.data (), data.size ());
+}
+
 static int log_level = 0;
 void set_log_level (int lvl) {
     log_level = lvl;
@@ -86,6 +152,12 @@ time time :: now () {
     return time (ts.tv_sec, ts.tv_nsec);
 }
 
+time time :: monotonic () {
+    time_type ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return time (ts.tv_sec, ts.tv_nsec);
+}
+
 time operator - (const time& lhs, const time& rhs) {
     time res (lhs.tm.tv_sec, lhs.tm.tv_nsec);
     res -= rhs;
@@ -1,6 +1,8 @@
 #pragma once
 #include <time.h>
 #include <string>
+#include <cstdint>
+#include <sys/types.h>
 
 const int EV_NANOSEC_IN_SEC = 1000 * 1000 * 1000;
 namespace ev {
@@ -21,6 +23,7 @@ public:
     std::string to_string () const;
 
     static time now ();
+    static time monotonic ();
 
     friend time operator - (const time&, const time&);
     friend time operator + (const time&, const time&);
@@ -59,6 +62,14 @@ public:
     friend bool operator < (const path&, const path&); /* To use as key in container */
 };
 
+std::string read_file (const path& filename);
+uint64_t parse_size (const std::string& str);  /* <n>[KMG] */
+void copy_file (const path& from, const path& to, mode_t mode);
+
+/* FNV-1a, for content keys that need to be stable, not secure */
+uint64_t fnv1a (const void *data, size_t len, uint64_t seed = 0xcbf29ce484222325ULL);
+uint64_t fnv1a (const std::string& data);
+
 void die_errno (const char *msg, int save_errno, int exit_status = EXIT_FAILURE);
 
 template <typename T, size_t hex_len = sizeof (T) * 2>